@@ -42,7 +42,8 @@ int main(int argc,char * argv[]) {
   int verbosity = 0;
   bool profile = false;
   
-  Kokkos::initialize();
+  // Kokkos strips its own arguments (e.g. --kokkos-threads=N), so this needs to happen before argv is parsed
+  Kokkos::initialize(argc, argv);
   
   Teuchos::RCP<LA_MpiComm> tcomm_LA;
   Teuchos::RCP<LA_MpiComm> tcomm_S;
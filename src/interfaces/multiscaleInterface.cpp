@@ -38,7 +38,10 @@ macro_functionManager(macro_functionManager_) {
     
     int nummodels = settings->sublist("Subgrid").get<int>("Number of Models",1);
     subgrid_static = settings->sublist("Subgrid").get<bool>("Static Subgrids",true);
-    
+    use_measured_cost = settings->sublist("Subgrid").get<bool>("Measured Cost",true);
+    // Solve subgrid problems on other ranks when the macro-scale partition is unbalanced
+    distribute_solves = settings->sublist("Subgrid").get<bool>("Distribute Solves",false);
+    rebalance_tol = settings->sublist("Subgrid").get<ScalarT>("Rebalance Tolerance",1.2);
     
     for (size_t n=0; n<subgridModels.size(); n++) {
       stringstream ss;
@@ -50,6 +53,30 @@ macro_functionManager(macro_functionManager_) {
   }
   else {
     subgrid_static = true;
+    use_measured_cost = false;
+    distribute_solves = false;
+  }
+  
+  if (distribute_solves) {
+    // The remote solves need a serial subgrid mesh and the same model on every element,
+    // and the stored fluxes are only available on the rank that solves the problem
+    bool supported = MacroComm->getSize() > 1 && subgrid_static;
+    for (size_t n=0; n<subgridModels.size(); n++) {
+      if (subgridModels[n]->LocalComm->getSize() > 1 || subgridModels[n]->store_aux_and_flux) {
+        supported = false;
+      }
+    }
+    if (!supported) {
+      distribute_solves = false;
+      if (MacroComm->getRank() == 0 && MacroComm->getSize() > 1) {
+        cout << "MILO warning: Distribute Solves requires static subgrid models on one rank each and no stored subgrid fluxes.  The subgrid problems will be solved on the rank that owns the macro-element." << endl;
+      }
+    }
+  }
+  if (distribute_solves) {
+    MPI_Comm solve_comm;
+    MPI_Comm_dup(*(MacroComm->getRawMpiComm()), &solve_comm);
+    SolveComm = Teuchos::rcp( new LA_MpiComm(solve_comm) );
   }
   
   if (milo_debug_level > 0) {
@@ -102,7 +129,7 @@ ScalarT MultiScale::initialize() {
       vector<size_t> sgnum(numElem,0);
       
       
-      macro_wkset[b]->update(cells[b][e]->ip,cells[b][e]->ijac,cells[b][e]->orientation);
+      cells[b][e]->updateWorksetBasis();
       macro_wkset[b]->computeSolnVolIP(cells[b][e]->u, cells[b][e]->u_dot, false, false);
       macro_wkset[b]->computeParamVolIP(cells[b][e]->param, false);
       
@@ -122,91 +149,27 @@ ScalarT MultiScale::initialize() {
       }
       
       if (subgrid_static) { // only add each cell to one subgrid model
-        DRV cellnodes = cells[b][e]->nodes;
-        Kokkos::View<int****,HostDevice> cellsideinfo = cells[b][e]->sideinfo;
-        Kokkos::View<GO**,HostDevice> GIDs = cells[b][e]->GIDs;
-        Kokkos::View<LO***,HostDevice> index = cells[b][e]->index;
-        
         for (int c=0; c<numElem; c++) {
-          DRV cnodes("cnodes",1,cellnodes.extent(1),cellnodes.extent(2));
-          Kokkos::View<int****,HostDevice> csideinfo("csideinfo",1,cellsideinfo.extent(1),
-                                                     cellsideinfo.extent(2),
-                                                     cellsideinfo.extent(3));
-          Kokkos::View<GO**,HostDevice> cGIDs("GIDs",1,GIDs.extent(1));
-          Kokkos::View<LO***,HostDevice> cindex("index",1,index.extent(1), index.extent(2));
-          
-          for (int i=0; i<cellnodes.extent(1); i++) {
-            for (int j=0; j<cellnodes.extent(2); j++) {
-              cnodes(0,i,j) = cellnodes(c,i,j);
-            }
-          }
-          for (int i=0; i<cellsideinfo.extent(1); i++) {
-            for (int j=0; j<cellsideinfo.extent(2); j++) {
-              for (int k=0; k<cellsideinfo.extent(3); k++) {
-                csideinfo(0,i,j,k) = cellsideinfo(c,i,j,k);
-              }
-            }
-          }
-          for (int i=0; i<GIDs.extent(1); i++) {
-            cGIDs(0,i) = GIDs(c,i);
-          }
-          for (int i=0; i<index.extent(1); i++) {
-            for (int j=0; j<index.extent(2); j++) {
-              cindex(0,i,j) = index(c,i,j);
-            }
-          }
-          // needs to be updated
-          int cnum = subgridModels[sgnum[c]]->addMacro(cnodes, csideinfo, cells[b][e]->sidenames,
-                                                       cGIDs, cindex);
+          int cnum = this->addMacroElement(cells[b][e], c, sgnum[c]);
           usernum.push_back(cnum);
         }
       }
       else {
         // usernum is the same for all subgrid models
-        DRV cellnodes = cells[b][e]->nodes;
-        Kokkos::View<int****,HostDevice> cellsideinfo = cells[b][e]->sideinfo;
-        Kokkos::View<GO**,HostDevice> GIDs = cells[b][e]->GIDs;
-        Kokkos::View<LO***,HostDevice> index = cells[b][e]->index;
-        
         for (int c=0; c<numElem; c++) {
-          DRV cnodes("cnodes",1,cellnodes.extent(1),cellnodes.extent(2));
-          Kokkos::View<int****,HostDevice> csideinfo("csideinfo",1,cellsideinfo.extent(1),
-                                                     cellsideinfo.extent(2),
-                                                     cellsideinfo.extent(3));
-          Kokkos::View<GO**,HostDevice> cGIDs("GIDs",1,GIDs.extent(1));
-          Kokkos::View<LO***,HostDevice> cindex("index",1,index.extent(1), index.extent(2));
-          
-          for (int i=0; i<cellnodes.extent(1); i++) {
-            for (int j=0; j<cellnodes.extent(2); j++) {
-              cnodes(0,i,j) = cellnodes(c,i,j);
-            }
-          }
-          for (int i=0; i<cellsideinfo.extent(1); i++) {
-            for (int j=0; j<cellsideinfo.extent(2); j++) {
-              for (int k=0; k<cellsideinfo.extent(3); k++) {
-                csideinfo(0,i,j,k) = cellsideinfo(c,i,j,k);
-              }
-            }
-          }
-          for (int i=0; i<GIDs.extent(1); i++) {
-            cGIDs(0,i) = GIDs(c,i);
-          }
-          for (int i=0; i<index.extent(1); i++) {
-            for (int j=0; j<index.extent(2); j++) {
-              cindex(0,i,j) = index(c,i,j);
-            }
-          }
           for (size_t s=0; s<subgridModels.size(); s++) {
-            int cnum = subgridModels[s]->addMacro(cnodes, csideinfo,
-                                                  cells[b][e]->sidenames,
-                                                  cGIDs, cindex);
+            int cnum = this->addMacroElement(cells[b][e], c, s);
             usernum.push_back(cnum);
           }
         }
       }
       cells[b][e]->subgridModels = subgridModels;
-      cells[b][e]->subgrid_model_index.push_back(sgnum);
+      // subgrid_model_index[c] is the history of the model used by element c
+      for (int c=0; c<numElem; c++) {
+        cells[b][e]->subgrid_model_index.push_back(vector<size_t>(1,sgnum[c]));
+      }
       cells[b][e]->subgrid_usernum = usernum;
+      cells[b][e]->subgrid_cost = vector<ScalarT>(numElem,0.0);
       cells[b][e]->cellData->multiscale = true;
       for (int c=0; c<numElem; c++) {
         my_cost += subgridModels[sgnum[c]]->cost_estimate;
@@ -214,6 +177,32 @@ ScalarT MultiScale::initialize() {
     }
   }
   
+  ////////////////////////////////////////////////////////////////////////////////
+  // Assign the subgrid solves to the ranks
+  // This needs to happen before the models are finalized, so the local copies of
+  // elements owned by other ranks get their mesh data with the rest
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  if (distribute_solves) {
+    int myrank = SolveComm->getRank();
+    my_cost = 0.0;
+    remote_usernum = vector<std::map<std::tuple<int,int,int>,int> >(cells.size());
+    for (size_t b=0; b<cells.size(); b++) {
+      vector<vector<ScalarT> > costs;
+      for (size_t e=0; e<cells[b].size(); e++) {
+        int numElem = cells[b][e]->numElem;
+        cells[b][e]->subgrid_rank = vector<int>(numElem, myrank);
+        cells[b][e]->cellData->subgrid_distributed = true;
+        vector<ScalarT> cellcosts(numElem,0.0);
+        for (int c=0; c<numElem; c++) {
+          cellcosts[c] = subgridModels[cells[b][e]->subgrid_model_index[c][0]]->cost_estimate;
+        }
+        costs.push_back(cellcosts);
+      }
+      my_cost += this->distributeSolves(b, costs);
+    }
+  }
+  
   for (size_t s=0; s< subgridModels.size(); s++) {
     subgridModels[s]->finalize();
   }
@@ -314,25 +303,86 @@ ScalarT MultiScale::initialize() {
   return my_cost;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Add one element of a macro-cell to a subgrid model (returns the usernum)
+////////////////////////////////////////////////////////////////////////////////
+
+int MultiScale::addMacroElement(Teuchos::RCP<cell> & macrocell, const int & c, const size_t & model) {
+  DRV cellnodes = macrocell->nodes;
+  Kokkos::View<int****,HostDevice> cellsideinfo = macrocell->sideinfo;
+  Kokkos::View<GO**,HostDevice> GIDs = macrocell->GIDs;
+  Kokkos::View<LO***,HostDevice> index = macrocell->index;
+  
+  DRV cnodes("cnodes",1,cellnodes.extent(1),cellnodes.extent(2));
+  Kokkos::View<int****,HostDevice> csideinfo("csideinfo",1,cellsideinfo.extent(1),
+                                             cellsideinfo.extent(2),
+                                             cellsideinfo.extent(3));
+  Kokkos::View<GO**,HostDevice> cGIDs("GIDs",1,GIDs.extent(1));
+  Kokkos::View<LO***,HostDevice> cindex("index",1,index.extent(1), index.extent(2));
+  
+  for (int i=0; i<cellnodes.extent(1); i++) {
+    for (int j=0; j<cellnodes.extent(2); j++) {
+      cnodes(0,i,j) = cellnodes(c,i,j);
+    }
+  }
+  for (int i=0; i<cellsideinfo.extent(1); i++) {
+    for (int j=0; j<cellsideinfo.extent(2); j++) {
+      for (int k=0; k<cellsideinfo.extent(3); k++) {
+        csideinfo(0,i,j,k) = cellsideinfo(c,i,j,k);
+      }
+    }
+  }
+  for (int i=0; i<GIDs.extent(1); i++) {
+    cGIDs(0,i) = GIDs(c,i);
+  }
+  for (int i=0; i<index.extent(1); i++) {
+    for (int j=0; j<index.extent(2); j++) {
+      cindex(0,i,j) = index(c,i,j);
+    }
+  }
+  // needs to be updated
+  return subgridModels[model]->addMacro(cnodes, csideinfo, macrocell->sidenames,
+                                        cGIDs, cindex);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Re-assignment of subgrid models to cells
 ////////////////////////////////////////////////////////////////////////////////
 
 ScalarT MultiScale::update() {
-  ScalarT my_cost = 1.0;
+  ScalarT my_cost = 0.0;
   
   if (subgrid_static) {
+    ScalarT my_load = 0.0;
     for (size_t b=0; b<cells.size(); b++) {
+      vector<vector<ScalarT> > blockcosts;
       for (size_t e=0; e<cells[b].size(); e++) {
+        int numElem = cells[b][e]->numElem;
+        vector<ScalarT> costs(numElem,0.0);
         if (cells[b][e]->cellData->multiscale) {
-          int numElem = cells[b][e]->numElem;
           for (int c=0;c<numElem; c++) {
             int nummod = cells[b][e]->subgrid_model_index[c].size();
             int oldmodel = cells[b][e]->subgrid_model_index[c][nummod-1];
-            cells[b][e]->subgrid_model_index[c].push_back(oldmodel);
-            my_cost += subgridModels[oldmodel]->cost_estimate;
+            costs[c] = this->elementCost(cells[b][e], c, oldmodel, oldmodel);
+            my_cost += costs[c];
+          }
+          for (int c=0;c<numElem; c++) {
+            int nummod = cells[b][e]->subgrid_model_index[c].size();
+            int currmodel = cells[b][e]->subgrid_model_index[c][nummod-1];
+            cells[b][e]->subgrid_model_index[c].push_back(currmodel);
           }
         }
+        blockcosts.push_back(costs);
+      }
+      // Move the subgrid solves between the ranks using the measured costs
+      if (distribute_solves) {
+        my_load += this->distributeSolves(b, blockcosts);
+      }
+    }
+    if (distribute_solves) {
+      my_cost = my_load;
+      for (size_t s=0; s<subgridModels.size(); s++) {
+        subgridModels[s]->finalize();
       }
     }
   }
@@ -347,7 +397,7 @@ ScalarT MultiScale::update() {
           int numElem = cells[b][e]->numElem;
           vector<size_t> newmodel(numElem,0);
           
-          macro_wkset[b]->update(cells[b][e]->ip,cells[b][e]->ijac,cells[b][e]->orientation);
+          cells[b][e]->updateWorksetBasis();
           macro_wkset[b]->computeSolnVolIP(cells[b][e]->u, cells[b][e]->u_dot, false, false);
           macro_wkset[b]->computeParamVolIP(cells[b][e]->param, false);
           
@@ -373,9 +423,9 @@ ScalarT MultiScale::update() {
               
               int usernum = cells[b][e]->subgrid_usernum[c];
               // get the time/solution from old subgrid model at last time step
-              int lastindex = subgridModels[oldmodel]->soln->times[usernum].size()-1;
-              Teuchos::RCP< Tpetra::MultiVector<ScalarT,LO,GO,HostNode> > lastsol = subgridModels[oldmodel]->soln->data[usernum][lastindex];
-              ScalarT lasttime = subgridModels[oldmodel]->soln->times[usernum][lastindex];
+              Teuchos::RCP< Tpetra::MultiVector<ScalarT,LO,GO,HostNode> > lastsol;
+              ScalarT lasttime;
+              bool fnd = subgridModels[oldmodel]->soln->extractLast(lastsol, usernum, lasttime);
               Teuchos::RCP<Tpetra::MultiVector<ScalarT,LO,GO,HostNode> > projvec =
                         Teuchos::rcp(new Tpetra::MultiVector<ScalarT,LO,GO,HostNode>(subgridModels[newmodel[c]]->owned_map,1));
               subgrid_projection_maps[newmodel[c]][oldmodel]->apply(*lastsol, *projvec);
@@ -394,7 +444,7 @@ ScalarT MultiScale::update() {
               //cells[b][e]->subgridModel = subgridModels[newmodel];
               
             }
-            my_cost += subgridModels[newmodel[c]]->cost_estimate;
+            my_cost += this->elementCost(cells[b][e], c, oldmodel, newmodel[c]);
             cells[b][e]->subgrid_model_index[c].push_back(newmodel[c]);
           }
         }
@@ -405,6 +455,424 @@ ScalarT MultiScale::update() {
   return my_cost;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Cost of an element for the next time step
+// The measured solve time from the last time step is used when it is available.
+// If the element changes model, the time is scaled by the ratio of the static estimates.
+////////////////////////////////////////////////////////////////////////////////
+
+ScalarT MultiScale::elementCost(Teuchos::RCP<cell> & macrocell, const int & c,
+                                const size_t & oldmodel, const size_t & newmodel) {
+  ScalarT cost = subgridModels[newmodel]->cost_estimate;
+  if (use_measured_cost && macrocell->subgrid_cost.size() > (size_t)c) {
+    ScalarT measured = macrocell->subgrid_cost[c];
+    if (measured > 0.0) {
+      cost = measured;
+      if (newmodel != oldmodel && subgridModels[oldmodel]->cost_estimate > 0.0) {
+        cost *= subgridModels[newmodel]->cost_estimate/subgridModels[oldmodel]->cost_estimate;
+      }
+    }
+    macrocell->subgrid_cost[c] = 0.0;
+  }
+  return cost;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Assign the subgrid solves of a block to the ranks
+// A step takes as long as the most loaded rank.  If it is more than rebalance_tol
+// times the average load, the elements are reassigned greedily (largest cost first):
+// an element stays on its rank if that rank remains below the tolerance, otherwise it
+// goes to the least loaded rank.  The new assignment is only used if it lowers the
+// maximum load.  Every rank computes the same assignment from the gathered costs.
+// The rank that owns a macro-element keeps its subgrid history; the rank that solves it
+// adds a local copy of the element to the same subgrid model, which is released (and its
+// usernum reused) when the element moves again.
+////////////////////////////////////////////////////////////////////////////////
+
+ScalarT MultiScale::distributeSolves(const size_t & block, const vector<vector<ScalarT> > & costs) {
+  
+  MPI_Comm comm = *(SolveComm->getRawMpiComm());
+  int myrank = SolveComm->getRank();
+  int numranks = SolveComm->getSize();
+  
+  vector<ScalarT> mycosts, myranks;
+  for (size_t e=0; e<cells[block].size(); e++) {
+    for (int c=0; c<cells[block][e]->numElem; c++) {
+      mycosts.push_back(costs[e][c]);
+      myranks.push_back(cells[block][e]->subgrid_rank[c]);
+    }
+  }
+  int mycount = mycosts.size();
+  mycosts.push_back(0.0); // MPI needs valid buffers when there are no elements
+  myranks.push_back(0.0);
+  
+  vector<int> counts(numranks,0), displ(numranks+1,0);
+  MPI_Allgather(&mycount, 1, MPI_INT, &counts[0], 1, MPI_INT, comm);
+  for (int r=0; r<numranks; r++) {
+    displ[r+1] = displ[r] + counts[r];
+  }
+  int total = displ[numranks];
+  vector<ScalarT> allcosts(total+1,0.0), allranks(total+1,0.0);
+  MPI_Allgatherv(&mycosts[0], mycount, MPI_DOUBLE, &allcosts[0], &counts[0], &displ[0], MPI_DOUBLE, comm);
+  MPI_Allgatherv(&myranks[0], mycount, MPI_DOUBLE, &allranks[0], &counts[0], &displ[0], MPI_DOUBLE, comm);
+  
+  vector<int> newranks(total);
+  vector<ScalarT> load(numranks,0.0);
+  ScalarT totalload = 0.0;
+  for (int k=0; k<total; k++) {
+    newranks[k] = (int)allranks[k];
+    load[newranks[k]] += allcosts[k];
+    totalload += allcosts[k];
+  }
+  ScalarT maxload = rebalance_tol*totalload/(ScalarT)numranks;
+  ScalarT oldmax = *std::max_element(load.begin(), load.end());
+  
+  if (totalload > 0.0 && oldmax > maxload) {
+    vector<int> order(total);
+    for (int k=0; k<total; k++) {
+      order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(), [&allcosts](const int & i, const int & j) { return allcosts[i] > allcosts[j]; });
+    vector<int> placement(total);
+    vector<ScalarT> newload(numranks,0.0);
+    for (int k=0; k<total; k++) {
+      int i = order[k];
+      int best = (int)allranks[i];
+      if (newload[best] + allcosts[i] > maxload) {
+        for (int r=0; r<numranks; r++) {
+          if (newload[r] < newload[best]) {
+            best = r;
+          }
+        }
+      }
+      placement[i] = best;
+      newload[best] += allcosts[i];
+    }
+    ScalarT newmax = *std::max_element(newload.begin(), newload.end());
+    if (newmax < oldmax) {
+      newranks = placement;
+      load = newload;
+    }
+  }
+  
+  // Release the copies on the ranks that no longer solve an element, then send the
+  // geometry and mesh data to the ranks that will (after the releases, so the usernums
+  // are reused)
+  vector<vector<ScalarT> > releasebuf(numranks), addbuf(numranks);
+  int k = displ[myrank];
+  for (size_t e=0; e<cells[block].size(); e++) {
+    Teuchos::RCP<cell> mcell = cells[block][e];
+    for (int c=0; c<mcell->numElem; c++) {
+      int rank = newranks[k];
+      int oldrank = mcell->subgrid_rank[c];
+      size_t sgindex = mcell->subgrid_model_index[c][mcell->subgrid_model_index[c].size()-1];
+      if (rank != oldrank && oldrank != myrank) {
+        vector<ScalarT> & buf = releasebuf[oldrank];
+        buf.push_back(e);
+        buf.push_back(c);
+        buf.push_back(sgindex);
+      }
+      if (rank != oldrank && rank != myrank) {
+        vector<ScalarT> & buf = addbuf[rank];
+        buf.push_back(e);
+        buf.push_back(c);
+        buf.push_back(sgindex);
+        buf.push_back(mcell->nodes.extent(1));
+        buf.push_back(mcell->nodes.extent(2));
+        for (size_t i=0; i<mcell->nodes.extent(1); i++) {
+          for (size_t j=0; j<mcell->nodes.extent(2); j++) {
+            buf.push_back(mcell->nodes(c,i,j));
+          }
+        }
+        buf.push_back(mcell->sideinfo.extent(1));
+        buf.push_back(mcell->sideinfo.extent(2));
+        buf.push_back(mcell->sideinfo.extent(3));
+        for (size_t i=0; i<mcell->sideinfo.extent(1); i++) {
+          for (size_t j=0; j<mcell->sideinfo.extent(2); j++) {
+            for (size_t n=0; n<mcell->sideinfo.extent(3); n++) {
+              buf.push_back(mcell->sideinfo(c,i,j,n));
+            }
+          }
+        }
+        buf.push_back(mcell->GIDs.extent(1));
+        for (size_t i=0; i<mcell->GIDs.extent(1); i++) {
+          buf.push_back(mcell->GIDs(c,i));
+        }
+        buf.push_back(mcell->index.extent(1));
+        buf.push_back(mcell->index.extent(2));
+        for (size_t i=0; i<mcell->index.extent(1); i++) {
+          for (size_t j=0; j<mcell->index.extent(2); j++) {
+            buf.push_back(mcell->index(c,i,j));
+          }
+        }
+        subgridModels[sgindex]->packCellData(mcell->subgrid_usernum[c], buf);
+      }
+      mcell->subgrid_rank[c] = rank;
+      k++;
+    }
+  }
+  
+  vector<vector<ScalarT> > recvbuf;
+  this->exchange(releasebuf, recvbuf);
+  for (int r=0; r<numranks; r++) {
+    size_t pos = 0;
+    while (pos < recvbuf[r].size()) {
+      int e = recvbuf[r][pos++];
+      int c = recvbuf[r][pos++];
+      size_t model = recvbuf[r][pos++];
+      auto usernum = remote_usernum[block].find(std::make_tuple(r,e,c));
+      TEUCHOS_TEST_FOR_EXCEPTION(usernum == remote_usernum[block].end(),std::runtime_error,"Error: MILO was asked to release a subgrid problem that was not assigned to this rank");
+      subgridModels[model]->removeMacro(usernum->second);
+      remote_usernum[block].erase(usernum);
+    }
+  }
+  
+  this->exchange(addbuf, recvbuf);
+  for (int r=0; r<numranks; r++) {
+    size_t pos = 0;
+    while (pos < recvbuf[r].size()) {
+      const vector<ScalarT> & buf = recvbuf[r];
+      int e = buf[pos++];
+      int c = buf[pos++];
+      size_t model = buf[pos++];
+      size_t n1 = buf[pos++], n2 = buf[pos++];
+      DRV cnodes("cnodes",1,n1,n2);
+      for (size_t i=0; i<n1; i++) {
+        for (size_t j=0; j<n2; j++) {
+          cnodes(0,i,j) = buf[pos++];
+        }
+      }
+      size_t s1 = buf[pos++], s2 = buf[pos++], s3 = buf[pos++];
+      Kokkos::View<int****,HostDevice> csideinfo("csideinfo",1,s1,s2,s3);
+      for (size_t i=0; i<s1; i++) {
+        for (size_t j=0; j<s2; j++) {
+          for (size_t n=0; n<s3; n++) {
+            csideinfo(0,i,j,n) = buf[pos++];
+          }
+        }
+      }
+      size_t g1 = buf[pos++];
+      Kokkos::View<GO**,HostDevice> cGIDs("GIDs",1,g1);
+      for (size_t i=0; i<g1; i++) {
+        cGIDs(0,i) = buf[pos++];
+      }
+      size_t i1 = buf[pos++], i2 = buf[pos++];
+      Kokkos::View<LO***,HostDevice> cindex("index",1,i1,i2);
+      for (size_t i=0; i<i1; i++) {
+        for (size_t j=0; j<i2; j++) {
+          cindex(0,i,j) = buf[pos++];
+        }
+      }
+      int usernum = subgridModels[model]->addMacro(cnodes, csideinfo, cells[block][0]->sidenames,
+                                                   cGIDs, cindex);
+      subgridModels[model]->unpackCellData(usernum, buf, pos);
+      remote_usernum[block][std::make_tuple(r,e,c)] = usernum;
+    }
+  }
+  
+  return load[myrank];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Solve the subgrid problems of a block
+// The owner of each macro-element sends the macro-solution and the subgrid solutions
+// the solve needs (SubGridModel::packState) to the rank assigned by distributeSolves,
+// which returns the subgrid flux, the gradient, the solve time and the new subgrid
+// solution.  The adjoint problems are solved by the owner, since the sensor data and
+// the previous adjoint contributions are stored there.
+// The fluxes are added to the workset residual by cell::addSubgridFluxes.
+////////////////////////////////////////////////////////////////////////////////
+
+void MultiScale::computeSubgridSolutions(const size_t & block, const ScalarT & time,
+                                         const bool & isTransient, const bool & isAdjoint,
+                                         const bool & compute_jacobian, const bool & compute_sens,
+                                         const int & num_active_params, const bool & compute_disc_sens,
+                                         const bool & compute_aux_sens, const bool & store_adjPrev) {
+  
+  int myrank = SolveComm->getRank();
+  int numranks = SolveComm->getSize();
+  workset & macrowkset = *(macro_wkset[block]);
+  size_t numres = macrowkset.res.extent(1);
+  
+  vector<vector<ScalarT> > requests(numranks);
+  for (size_t e=0; e<cells[block].size(); e++) {
+    Teuchos::RCP<cell> mcell = cells[block][e];
+    int numElem = mcell->numElem;
+    if (mcell->subgrid_flux.extent(0) != (size_t)numElem || mcell->subgrid_flux.extent(1) != numres) {
+      mcell->subgrid_flux = Kokkos::View<AD**,AssemblyDevice>("subgrid flux",numElem,numres);
+    }
+    for (int c=0; c<numElem; c++) {
+      for (size_t j=0; j<numres; j++) {
+        mcell->subgrid_flux(c,j) = 0.0;
+      }
+      int rank = mcell->subgrid_rank[c];
+      if (!isAdjoint && rank != myrank) {
+        size_t sgindex = mcell->subgrid_model_index[c][mcell->subgrid_model_index[c].size()-1];
+        vector<ScalarT> & buf = requests[rank];
+        buf.push_back(e);
+        buf.push_back(c);
+        buf.push_back(sgindex);
+        buf.push_back(mcell->subgradient.extent(0));
+        buf.push_back(mcell->subgradient.extent(1));
+        buf.push_back(mcell->u.extent(1));
+        buf.push_back(mcell->u.extent(2));
+        for (size_t i=0; i<mcell->u.extent(1); i++) {
+          for (size_t j=0; j<mcell->u.extent(2); j++) {
+            buf.push_back(mcell->u(c,i,j));
+          }
+        }
+        subgridModels[sgindex]->packState(mcell->subgrid_usernum[c], time, compute_sens, buf);
+      }
+    }
+  }
+  
+  vector<vector<ScalarT> > received;
+  this->exchange(requests, received);
+  
+  // Elements solved on this rank
+  for (size_t e=0; e<cells[block].size(); e++) {
+    Teuchos::RCP<cell> mcell = cells[block][e];
+    for (int c=0; c<mcell->numElem; c++) {
+      if (isAdjoint || mcell->subgrid_rank[c] == myrank) {
+        size_t sgindex = mcell->subgrid_model_index[c][mcell->subgrid_model_index[c].size()-1];
+        for (size_t j=0; j<numres; j++) {
+          macrowkset.res(c,j) = 0.0;
+        }
+        double start = Teuchos::Time::wallTime();
+        subgridModels[sgindex]->subgridSolver(mcell->u, mcell->phi, time, isTransient, isAdjoint,
+                                              compute_jacobian, compute_sens, num_active_params,
+                                              compute_disc_sens, compute_aux_sens,
+                                              macrowkset, mcell->subgrid_usernum[c], c,
+                                              mcell->subgradient, store_adjPrev);
+        mcell->addSubgridCost(c, Teuchos::Time::wallTime() - start);
+        for (size_t j=0; j<numres; j++) {
+          mcell->subgrid_flux(c,j) = macrowkset.res(c,j);
+          macrowkset.res(c,j) = 0.0;
+        }
+      }
+    }
+  }
+  
+  // Elements solved for other ranks
+  vector<vector<ScalarT> > results(numranks);
+  for (int r=0; r<numranks; r++) {
+    const vector<ScalarT> & buf = received[r];
+    size_t pos = 0;
+    while (pos < buf.size()) {
+      int e = buf[pos++];
+      int c = buf[pos++];
+      size_t sgindex = buf[pos++];
+      size_t numgrad = buf[pos++], numparams = buf[pos++];
+      size_t n1 = buf[pos++], n2 = buf[pos++];
+      Kokkos::View<ScalarT***,AssemblyDevice> ru("subgrid macro solution",1,n1,n2);
+      for (size_t i=0; i<n1; i++) {
+        for (size_t j=0; j<n2; j++) {
+          ru(0,i,j) = buf[pos++];
+        }
+      }
+      auto usernum = remote_usernum[block].find(std::make_tuple(r,e,c));
+      TEUCHOS_TEST_FOR_EXCEPTION(usernum == remote_usernum[block].end(),std::runtime_error,"Error: MILO received a subgrid problem that was not assigned to this rank");
+      subgridModels[sgindex]->unpackState(usernum->second, buf, pos);
+      
+      Kokkos::View<ScalarT**,AssemblyDevice> grad("subgrid gradient",numgrad,numparams);
+      for (size_t j=0; j<numres; j++) {
+        macrowkset.res(0,j) = 0.0;
+      }
+      double start = Teuchos::Time::wallTime();
+      subgridModels[sgindex]->subgridSolver(ru, ru, time, isTransient, isAdjoint,
+                                            compute_jacobian, compute_sens, num_active_params,
+                                            compute_disc_sens, compute_aux_sens,
+                                            macrowkset, usernum->second, 0,
+                                            grad, store_adjPrev);
+      double solvetime = Teuchos::Time::wallTime() - start;
+      
+      vector<ScalarT> & result = results[r];
+      result.push_back(e);
+      result.push_back(c);
+      result.push_back(solvetime);
+      for (size_t j=0; j<numres; j++) {
+        result.push_back(macrowkset.res(0,j).val());
+        for (int d=0; d<maxDerivs; d++) {
+          result.push_back(macrowkset.res(0,j).fastAccessDx(d));
+        }
+        macrowkset.res(0,j) = 0.0;
+      }
+      for (size_t i=0; i<numgrad; i++) {
+        for (size_t j=0; j<numparams; j++) {
+          result.push_back(grad(i,j));
+        }
+      }
+      subgridModels[sgindex]->packResult(usernum->second, time, compute_sens, result);
+    }
+  }
+  
+  vector<vector<ScalarT> > returned;
+  this->exchange(results, returned);
+  
+  for (int r=0; r<numranks; r++) {
+    const vector<ScalarT> & buf = returned[r];
+    size_t pos = 0;
+    while (pos < buf.size()) {
+      int e = buf[pos++];
+      int c = buf[pos++];
+      ScalarT solvetime = buf[pos++];
+      Teuchos::RCP<cell> mcell = cells[block][e];
+      for (size_t j=0; j<numres; j++) {
+        mcell->subgrid_flux(c,j).val() = buf[pos++];
+        for (int d=0; d<maxDerivs; d++) {
+          mcell->subgrid_flux(c,j).fastAccessDx(d) = buf[pos++];
+        }
+      }
+      // subgridSolver resets the gradient, so the last element sets it (as in cell::computeSubgridSolutions)
+      bool lastelem = (c == mcell->numElem-1);
+      for (size_t i=0; i<mcell->subgradient.extent(0); i++) {
+        for (size_t j=0; j<mcell->subgradient.extent(1); j++) {
+          if (lastelem) {
+            mcell->subgradient(i,j) = buf[pos];
+          }
+          pos++;
+        }
+      }
+      mcell->addSubgridCost(c, solvetime);
+      size_t sgindex = mcell->subgrid_model_index[c][mcell->subgrid_model_index[c].size()-1];
+      subgridModels[sgindex]->unpackResult(mcell->subgrid_usernum[c], buf, pos);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Send one buffer to each rank of SolveComm and receive one from each
+////////////////////////////////////////////////////////////////////////////////
+
+void MultiScale::exchange(const vector<vector<ScalarT> > & sendbuf, vector<vector<ScalarT> > & recvbuf) {
+  
+  MPI_Comm comm = *(SolveComm->getRawMpiComm());
+  int numranks = SolveComm->getSize();
+  
+  vector<int> sendcounts(numranks,0), recvcounts(numranks,0);
+  vector<int> senddispl(numranks+1,0), recvdispl(numranks+1,0);
+  for (int r=0; r<numranks; r++) {
+    sendcounts[r] = sendbuf[r].size();
+  }
+  MPI_Alltoall(&sendcounts[0], 1, MPI_INT, &recvcounts[0], 1, MPI_INT, comm);
+  for (int r=0; r<numranks; r++) {
+    senddispl[r+1] = senddispl[r] + sendcounts[r];
+    recvdispl[r+1] = recvdispl[r] + recvcounts[r];
+  }
+  
+  vector<ScalarT> sendall(senddispl[numranks]+1), recvall(recvdispl[numranks]+1);
+  for (int r=0; r<numranks; r++) {
+    std::copy(sendbuf[r].begin(), sendbuf[r].end(), sendall.begin()+senddispl[r]);
+  }
+  MPI_Alltoallv(&sendall[0], &sendcounts[0], &senddispl[0], MPI_DOUBLE,
+                &recvall[0], &recvcounts[0], &recvdispl[0], MPI_DOUBLE, comm);
+  
+  recvbuf = vector<vector<ScalarT> >(numranks);
+  for (int r=0; r<numranks; r++) {
+    recvbuf[r] = vector<ScalarT>(recvall.begin()+recvdispl[r], recvall.begin()+recvdispl[r+1]);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Reset the time step
 ////////////////////////////////////////////////////////////////////////////////
@@ -415,6 +883,16 @@ void MultiScale::reset() {
   //}
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Remove the subgrid states computed for a rejected macro time step
+////////////////////////////////////////////////////////////////////////////////
+
+void MultiScale::eraseTime(const ScalarT & time) {
+  for (size_t s=0; s<subgridModels.size(); s++) {
+    subgridModels[s]->eraseTime(time);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Post-processing
 ////////////////////////////////////////////////////////////////////////////////
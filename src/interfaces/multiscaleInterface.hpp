@@ -17,6 +17,8 @@
 #include "cell.hpp"
 #include "subgridModel.hpp"
 #include "Amesos2.hpp"
+#include <map>
+#include <tuple>
 
 using namespace std;
 using namespace Intrepid2;
@@ -63,8 +65,51 @@ class MultiScale {
   
   ScalarT update();
   
+  ////////////////////////////////////////////////////////////////////////////////
+  // Cost of an element for the next time step (measured or estimated)
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  ScalarT elementCost(Teuchos::RCP<cell> & macrocell, const int & c,
+                      const size_t & oldmodel, const size_t & newmodel);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Add one element of a macro-cell to a subgrid model (returns the usernum)
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  int addMacroElement(Teuchos::RCP<cell> & macrocell, const int & c, const size_t & model);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Assign the subgrid solves of a block to the ranks using the element costs
+  // (returns the cost assigned to this rank)
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  ScalarT distributeSolves(const size_t & block, const vector<vector<ScalarT> > & costs);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Solve the subgrid problems of a block on the ranks assigned by distributeSolves
+  // Must be called by all ranks (between the gather and the cell loop of the assembly)
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void computeSubgridSolutions(const size_t & block, const ScalarT & time,
+                               const bool & isTransient, const bool & isAdjoint,
+                               const bool & compute_jacobian, const bool & compute_sens,
+                               const int & num_active_params, const bool & compute_disc_sens,
+                               const bool & compute_aux_sens, const bool & store_adjPrev);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Send one buffer to each rank of SolveComm and receive one from each
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void exchange(const vector<vector<ScalarT> > & sendbuf, vector<vector<ScalarT> > & recvbuf);
+  
   void reset();
   
+  ////////////////////////////////////////////////////////////////////////////////
+  // Remove the subgrid states computed for a rejected macro time step
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void eraseTime(const ScalarT & time);
+  
   ////////////////////////////////////////////////////////////////////////////////
   // Post-processing
   ////////////////////////////////////////////////////////////////////////////////
@@ -98,8 +143,14 @@ class MultiScale {
   
   bool subgrid_static;
   int milo_debug_level;
+  bool use_measured_cost; // use the measured subgrid solve times instead of cost_estimate
+  bool distribute_solves; // solve subgrid problems on other ranks when the loads are unbalanced
+  ScalarT rebalance_tol; // allowed ratio of the largest rank load to the average
   vector<Teuchos::RCP<SubGridModel> > subgridModels;
   Teuchos::RCP<LA_MpiComm> Comm, MacroComm;
+  Teuchos::RCP<LA_MpiComm> SolveComm; // duplicate of MacroComm for the subgrid solve exchanges
+  // usernum of the local copies of the elements solved for other ranks (owner, cell, element)
+  vector<std::map<std::tuple<int,int,int>,int> > remote_usernum;
   Teuchos::RCP<Teuchos::ParameterList> settings;
   vector<vector<Teuchos::RCP<cell> > > cells;
   vector<Teuchos::RCP<workset> > macro_wkset;
@@ -54,16 +54,35 @@ Comm(Comm_), mesh(mesh_), disc(disc_), phys(phys_), DOF(DOF_), assembler(assembl
     numsteps = settings->sublist("Solver").get<int>("numSteps",1);
     deltat = (final_time - initial_time)/numsteps;
   }
+  initial_deltat = deltat;
+  maxCuts = settings->sublist("Solver").get<int>("maximum time step cuts",5);
+  
+  // Error-controlled adaptive time stepping (PI controller on a local truncation error estimate)
+  adaptive_timestep = settings->sublist("Solver").get<bool>("adaptive time stepping",false);
+  dt_tol_rel = settings->sublist("Solver").get<ScalarT>("time step relative tolerance",1.0e-3);
+  dt_tol_abs = settings->sublist("Solver").get<ScalarT>("time step absolute tolerance",1.0e-6);
+  dt_min = settings->sublist("Solver").get<ScalarT>("minimum delta t",1.0e-6*deltat);
+  dt_max = settings->sublist("Solver").get<ScalarT>("maximum delta t",final_time - initial_time);
+  dt_growth = settings->sublist("Solver").get<ScalarT>("maximum time step growth",2.0);
+  dt_safety = settings->sublist("Solver").get<ScalarT>("time step safety factor",0.9);
+  TEUCHOS_TEST_FOR_EXCEPTION(adaptive_timestep && (dt_min <= 0.0 || dt_max < dt_min || dt_growth < 1.0),std::runtime_error,"Error: MILO requires 0 < minimum delta t <= maximum delta t and maximum time step growth >= 1 for adaptive time stepping");
+  TEUCHOS_TEST_FOR_EXCEPTION(adaptive_timestep && settings->isSublist("Subgrid"),std::runtime_error,"Error: adaptive time stepping is not available for multiscale problems since the subgrid models use a fixed macro time step");
   verbosity = settings->get<int>("verbosity",0);
   usestrongDBCs = settings->sublist("Solver").get<bool>("use strong DBCs",true);
   use_meas_as_dbcs = settings->sublist("Mesh").get<bool>("Use Measurements as DBCs", false);
   solver_type = settings->sublist("Solver").get<string>("solver","none"); // or "transient"
   allow_remesh = settings->sublist("Solver").get<bool>("Remesh",false);
+  checkpoint_storage = settings->sublist("Solver").get<int>("checkpoint storage",0); // 0 = store every state
+  TEUCHOS_TEST_FOR_EXCEPTION(checkpoint_storage < 0,std::runtime_error,"Error: checkpoint storage must be non-negative");
+  TEUCHOS_TEST_FOR_EXCEPTION(checkpoint_storage > 0 && allow_remesh,std::runtime_error,"Error: checkpoint storage cannot be used with Remesh since the recomputed forward states would be on a different mesh");
   time_order = settings->sublist("Solver").get<int>("time order",1);
+  TEUCHOS_TEST_FOR_EXCEPTION(adaptive_timestep && time_order != 1,std::runtime_error,"Error: adaptive time stepping requires time order = 1 (BDF2 assumes a fixed time step)");
   NLtol = settings->sublist("Solver").get<ScalarT>("NLtol",1.0E-6);
   MaxNLiter = settings->sublist("Solver").get<int>("MaxNLiter",10);
   NLsolver = settings->sublist("Solver").get<string>("Nonlinear Solver","Newton");
-  line_search = false;//settings->sublist("Solver").get<bool>("Use Line Search","false");
+  line_search = settings->sublist("Solver").get<bool>("Use Line Search",false);
+  ls_max_backtracks = settings->sublist("Solver").get<int>("line search max backtracks",8);
+  ls_decrease = settings->sublist("Solver").get<ScalarT>("line search sufficient decrease",1.0e-4);
   store_adjPrev = false;
   
   isTransient = false;
@@ -95,6 +114,12 @@ Comm(Comm_), mesh(mesh_), disc(disc_), phys(phys_), DOF(DOF_), assembler(assembl
   smoother_type = settings->sublist("Solver").get<string>("Smoother type","CHEBYSHEV"); // or RELAXATION
   useLinearSolver = settings->sublist("Solver").get<bool>("use linear solver",true);
   lintol = settings->sublist("Solver").get<ScalarT>("lintol",1.0E-7);
+  lintol_current = lintol;
+  // Eisenstat-Walker forcing terms (choice 2) for the Newton linear solves (lintol is the lower bound)
+  use_eisenstat_walker = settings->sublist("Solver").get<bool>("use Eisenstat-Walker",false);
+  ew_eta0 = settings->sublist("Solver").get<ScalarT>("Eisenstat-Walker initial tolerance",0.1);
+  ew_eta_max = settings->sublist("Solver").get<ScalarT>("Eisenstat-Walker max tolerance",0.9);
+  ew_gamma = settings->sublist("Solver").get<ScalarT>("Eisenstat-Walker gamma",0.9);
   liniter = settings->sublist("Solver").get<int>("liniter",100);
   kspace = settings->sublist("Solver").get<int>("krylov vectors",100);
   useDomDecomp = settings->sublist("Solver").get<bool>("use dom decomp",false);
@@ -105,6 +130,48 @@ Comm(Comm_), mesh(mesh_), disc(disc_), phys(phys_), DOF(DOF_), assembler(assembl
   
   have_symbolic_factor = false;
   
+  // Reuse policy for the preconditioner and the direct factorization
+  // "none" rebuilds the MueLu hierarchy for every solve, "full" reuses it as is, and
+  // "S", "tP", "RP" or "RAP" keep the aggregates/prolongators and recompute the rest
+  prec_reuse_type = settings->sublist("Solver").get<string>("preconditioner reuse type","none");
+  prec_reuse_max = settings->sublist("Solver").get<int>("preconditioner reuse count",10);
+  prec_rebuild_iters = settings->sublist("Solver").get<int>("preconditioner rebuild iterations",0); // 0 = disabled
+  factor_reuse_max = settings->sublist("Solver").get<int>("factorization reuse count",0);
+  prec_reuse_num = 0;
+  factor_reuse_num = 0;
+  rebuild_prec = true;
+  prec_matrix = NULL;
+  factor_matrix = NULL;
+  reuse_adjoint = false;
+  reuse_alpha = 0.0;
+  
+  use_matrix_free = settings->sublist("Solver").get<bool>("use matrix free",false);
+  mf_prec_lag = settings->sublist("Solver").get<int>("matrix free preconditioner lag",5);
+  mf_lag_num = 0;
+  mf_derivative = settings->sublist("Solver").get<string>("matrix free derivative","finite difference"); // or AD
+  TEUCHOS_TEST_FOR_EXCEPTION(mf_derivative != "finite difference" && mf_derivative != "AD",std::runtime_error,"Error: unrecognized matrix free derivative: " + mf_derivative);
+  TEUCHOS_TEST_FOR_EXCEPTION(use_matrix_free && useDirect,std::runtime_error,"Error: the matrix-free Jacobian requires an iterative linear solver");
+  TEUCHOS_TEST_FOR_EXCEPTION(use_matrix_free && settings->isSublist("Subgrid"),std::runtime_error,"Error: the matrix-free Jacobian is not available for multiscale problems");
+  
+  // Preconditioner for the iterative solver: "AMG" uses MueLu on the full Jacobian and "block" splits
+  // the unknowns by variable (e.g., "ux,uy;pr") and uses MueLu on each diagonal block
+  prec_type = settings->sublist("Solver").get<string>("preconditioner type","AMG");
+  block_prec_type = settings->sublist("Solver").get<string>("block preconditioner type","Gauss-Seidel"); // or Jacobi
+  schur_type = settings->sublist("Solver").get<string>("Schur complement approximation","none"); // or SIMPLE, SIMPLEC
+  block_splits = settings->sublist("Solver").get<string>("block splits","");
+  TEUCHOS_TEST_FOR_EXCEPTION(prec_type != "AMG" && prec_type != "block",std::runtime_error,"Error: unrecognized preconditioner type: " + prec_type);
+  
+  // The MueLu hierarchies can be built and applied in single precision (with flexible GMRES in double)
+  prec_precision = settings->sublist("Solver").get<string>("preconditioner precision","double"); // or single
+  TEUCHOS_TEST_FOR_EXCEPTION(prec_precision != "double" && prec_precision != "single",std::runtime_error,"Error: unrecognized preconditioner precision: " + prec_precision);
+#ifndef MILO_HAVE_SINGLE_PRECISION
+  TEUCHOS_TEST_FOR_EXCEPTION(prec_precision == "single",std::runtime_error,"Error: a single precision preconditioner was requested, but MILO was not configured with MILO_ENABLE_MIXED_PRECISION or Tpetra is not instantiated on float");
+#endif
+  
+  TEUCHOS_TEST_FOR_EXCEPTION(prec_reuse_type != "none" && prec_reuse_type != "full" && prec_reuse_type != "S" &&
+                             prec_reuse_type != "tP" && prec_reuse_type != "RP" && prec_reuse_type != "RAP",
+                             std::runtime_error,"Error: unrecognized preconditioner reuse type: " + prec_reuse_type);
+  
   // needed information from the mesh
   mesh->mesh->getElementBlockNames(blocknames);
   
@@ -119,9 +186,25 @@ Comm(Comm_), mesh(mesh_), disc(disc_), phys(phys_), DOF(DOF_), assembler(assembl
   int timeintorder = settings->sublist("Solver").get<int>("Time order",1);
   bool timeintstagger = settings->sublist("Solver").get<bool>("Stagger solutions",true);
 
-  //if (timeinttype == "RK") {
-  //  timeInt = Teuchos::rcp(new RungeKutta(timeintmethod,timeintorder,timeintstagger));
-  //}
+  use_rk_stages = false;
+  use_explicit = false;
+  if (timeinttype == "RK") {
+    timeInt = Teuchos::rcp(new RungeKutta(timeintmethod,timeintorder,timeintstagger));
+    // backward Euler uses the original BDF path (time order)
+    if (solver_type == "transient" && !timeInt->isBackwardEuler()) {
+      if (timeInt->isExplicit()) {
+        use_explicit = true;
+      }
+      else {
+        TEUCHOS_TEST_FOR_EXCEPTION(!timeInt->isDiagonallyImplicit(),std::runtime_error,"Error: the transient solver only supports explicit or diagonally implicit Runge-Kutta methods");
+        use_rk_stages = true;
+      }
+    }
+  }
+  // Explicit methods: delta t is limited by CFL*hmin/(wave speed) if a CFL number is given
+  explicit_cfl = settings->sublist("Solver").get<ScalarT>("CFL number",0.0);
+  explicit_wave_speed = settings->sublist("Solver").get<ScalarT>("maximum wave speed",1.0);
+  mesh_hmin = 0.0;
   
   // needed information from the DOF manager
   DOF->getOwnedIndices(LA_owned);
@@ -343,7 +426,6 @@ void solver::setupLinearAlgebra() {
 
   LA_owned_map = Teuchos::rcp(new LA_Map(INVALID, LA_owned, 0, Comm));
   LA_overlapped_map = Teuchos::rcp(new LA_Map(INVALID, LA_ownedAndShared, 0, Comm));
-  LA_owned_graph = createCrsGraph(LA_owned_map);//Teuchos::rcp(new LA_CrsGraph(Copy, *LA_owned_map, 0));
   LA_overlapped_graph = Tpetra::createCrsGraph(LA_overlapped_map,maxNumEntPerRow);//Teuchos::rcp(new LA_CrsGraph(Copy, *LA_overlapped_map, 0));
   
   exporter = Teuchos::rcp(new LA_Export(LA_overlapped_map, LA_owned_map));
@@ -368,7 +450,7 @@ void solver::setupLinearAlgebra() {
       int numElem = assembler->cells[b][e]->numElem;
       
       // this should fail on the first iteration through if maxDerivs is not large enough
-      TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of degrees of freedom per element times the number of time stages.");
+      TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of degrees of freedom per element times the number of time stages.  Reconfigure with a larger MILO_MAX_DERIVS.");
       //vector<vector<vector<int> > > cellindices;
       Kokkos::View<LO***,AssemblyDevice> cellindices("Local DOF indices", numElem, numVars[b], maxBasis[b]);
       for (int p=0; p<numElem; p++) {
@@ -394,6 +476,14 @@ void solver::setupLinearAlgebra() {
         
       }
       assembler->cells[b][e]->setIndex(cellindices, numDOF_KV);
+      
+      Kokkos::View<LO**,HostDevice> LIDs("local DOF indices", numElem, gids.extent(1));
+      for (int p=0; p<numElem; p++) {
+        for (size_t i=0; i<gids.extent(1); i++) {
+          LIDs(p,i) = LA_overlapped_map->getLocalElement(gids(p,i));
+        }
+      }
+      assembler->cells[b][e]->LIDs = LIDs;
     }
     
     if (assembler->boundaryCells.size() > b) {
@@ -403,7 +493,7 @@ void solver::setupLinearAlgebra() {
         int numElem = assembler->boundaryCells[b][e]->numElem;
         
         // this should fail on the first iteration through if maxDerivs is not large enough
-        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of degrees of freedom per element times the number of time stages.");
+        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of degrees of freedom per element times the number of time stages.  Reconfigure with a larger MILO_MAX_DERIVS.");
         //vector<vector<vector<int> > > cellindices;
         Kokkos::View<LO***,AssemblyDevice> cellindices("Local DOF indices", numElem, numVars[b], maxBasis[b]);
         for (int p=0; p<numElem; p++) {
@@ -429,12 +519,67 @@ void solver::setupLinearAlgebra() {
           
         }
         assembler->boundaryCells[b][e]->setIndex(cellindices, numDOF_KV);
+        
+        Kokkos::View<LO**,HostDevice> LIDs("local DOF indices", numElem, gids.extent(1));
+        for (int p=0; p<numElem; p++) {
+          for (size_t i=0; i<gids.extent(1); i++) {
+            LIDs(p,i) = LA_overlapped_map->getLocalElement(gids(p,i));
+          }
+        }
+        assembler->boundaryCells[b][e]->LIDs = LIDs;
       }
     }
   }
   
   LA_overlapped_graph->fillComplete();
   
+  // Report if the AD type is much larger than needed (see MILO_MAX_DERIVS)
+  if (verbosity > 1) {
+    LO maxNumDOF = 0;
+    for (size_t b=0; b<assembler->cells.size(); b++) {
+      if (assembler->cells[b].size() > 0) {
+        maxNumDOF = std::max(maxNumDOF,(LO)assembler->cells[b][0]->GIDs.extent(1));
+      }
+    }
+    LO gmaxNumDOF = 0;
+    Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MAX,1,&maxNumDOF,&gmaxNumDOF);
+    if (Comm->getRank() == 0 && 2*gmaxNumDOF <= maxDerivs && params->num_active_params <= gmaxNumDOF) {
+      cout << "**** The AD type uses " << maxDerivs << " derivatives, but the largest number of DOF per element is "
+           << gmaxNumDOF << ".  Consider configuring with a smaller MILO_MAX_DERIVS." << endl;
+    }
+  }
+  
+  // The local-index insert uses the same local indices for rows and columns
+  if (!LA_overlapped_graph->getColMap()->isSameAs(*LA_overlapped_map)) {
+    assembler->use_local_insert = false;
+  }
+  
+  // The strong Dirichlet BCs are applied to a fixed list of local rows
+  assembler->setDirichletRows(LA_overlapped_map);
+  
+  // The owned graph is the export of the overlapped graph
+  LA_owned_graph = Tpetra::createCrsGraph(LA_owned_map,maxNumEntPerRow);
+  LA_owned_graph->doExport(*LA_overlapped_graph, *exporter, Tpetra::INSERT);
+  LA_owned_graph->fillComplete();
+  
+  // The Jacobians, residuals and updates used by the nonlinear solver are built once
+  // on the static graphs and refilled on every Newton iteration and time step
+  J = Teuchos::rcp(new LA_CrsMatrix(LA_owned_graph));
+  J_over = Teuchos::rcp(new LA_CrsMatrix(LA_overlapped_graph));
+  res = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  res_over = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  du = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  du_over = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  
+  if (use_matrix_free) {
+    mf_J = Teuchos::rcp(new MatrixFreeJacobian(assembler, LA_owned_map, LA_overlapped_map, exporter, importer));
+    mf_J->use_fd = (mf_derivative == "finite difference");
+  }
+  
+  if (prec_type == "block" && !useDirect) {
+    this->setupBlockPreconditioner();
+  }
+  
   if (milo_debug_level > 0) {
     if (Comm->getRank() == 0) {
       cout << "**** Finished solver::setupLinearAlgebra" << endl;
@@ -607,19 +752,9 @@ void solver::transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> &
     }
   }
   
-  //ScalarT deltat = 0.0;
+  // alpha is recomputed from the size of each time step
   ScalarT alpha = 0.0;
   ScalarT beta = 1.0;
-  //deltat = final_time / numsteps;
-  if (time_order == 1){
-    alpha = 1./deltat;
-  }
-  else if (time_order == 2) {
-    alpha = 3.0/2.0/deltat;
-  }
-  else {
-    alpha = 0.0; // would be better to print out an error message
-  }
   
   current_time = start_time;
   if (!useadjoint) { // forward solve - adaptive time stepping
@@ -630,30 +765,55 @@ void solver::transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> &
     u_dot->putScalar(0.0);
     zero_vec->putScalar(0.0);
     
+    // Copy of the last accepted state (needed if the time step gets cut or rejected)
+    vector_RCP u_last = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    vector_RCP u_dot_last = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    u_last->update(1.0, *u, 0.0);
+    u_dot_last->putScalar(0.0);
+    
+    deltat = initial_deltat;
+    if (use_explicit) {
+      this->setupLumpedMass();
+      if (explicit_cfl > 0.0) {
+        deltat = std::min(deltat, explicit_cfl*mesh_hmin/explicit_wave_speed);
+        if(Comm->getRank() == 0 && verbosity > 0) {
+          cout << "**** Explicit time step (CFL limited): " << deltat << endl;
+        }
+      }
+    }
+    
+    forward_times.clear();
+    forward_times.push_back(start_time);
+    if (checkpoint_storage > 0) {
+      // remove any states left over from a previous forward solve
+      vector<ScalarT> oldtimes = soln->times[0];
+      for (size_t j=0; j<oldtimes.size(); j++) {
+        if (oldtimes[j] > start_time + 1.0e-12) {
+          soln->erase(0, oldtimes[j]);
+          soln_dot->erase(0, oldtimes[j]);
+        }
+      }
+      size_t est_steps = (size_t)std::ceil((end_time - start_time)/deltat - 1.0e-8);
+      this->setForwardCheckpoints(est_steps);
+    }
+    
     obj = 0.0;
     int numCuts = 0;
-    int maxCuts = 5; // TMW: make this a user-defined input
+    ScalarT err_prev = 1.0;
+    
+    // The subgrid models for a step are chosen once, from the last accepted state
+    this->updateMultiscale();
+    
     while (abs(current_time - end_time)>1.0e-12 && numCuts<=maxCuts) {
       
+      if (adaptive_timestep && current_time + deltat > end_time) {
+        deltat = end_time - current_time;
+      }
       current_time += deltat;
+      alpha = this->timeStepAlpha(deltat);
       
       u_dot->putScalar(0.0);
       
-      ////////////////////////////////////////////////////////////////////////
-      // Allow the cells to change subgrid model
-      ////////////////////////////////////////////////////////////////////////
-      {
-        Teuchos::TimeMonitor localtimer(*msprojtimer);
-        ScalarT my_cost = multiscale_manager->update();
-        ScalarT gmin = 0.0;
-        Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MIN,1,&my_cost,&gmin);
-        ScalarT gmax = 0.0;
-        Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MAX,1,&my_cost,&gmin);
-        if(Comm->getRank() == 0 && verbosity>0) {
-          cout << "***** Load Balancing Factor " << gmax/gmin <<  endl;
-        }
-      }
-      
       if(Comm->getRank() == 0 && verbosity > 0) {
         cout << endl << endl << "*******************************************************" << endl;
         cout << endl << "**** Beginning Time Step " << endl;
@@ -661,21 +821,48 @@ void solver::transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> &
         cout << "*******************************************************" << endl << endl << endl;
       }
       
-      int status = this->nonlinearSolver(u, u_dot, zero_vec, zero_vec, alpha, beta);
+      int status = 0;
+      if (use_explicit) {
+        status = this->explicitStep(u, u_dot, u_last, current_time - deltat);
+      }
+      else if (use_rk_stages) {
+        status = this->rungeKuttaStep(u, u_dot, u_last, current_time - deltat, beta);
+      }
+      else {
+        status = this->nonlinearSolver(u, u_dot, zero_vec, zero_vec, alpha, beta);
+      }
+      
+      // Estimate of the local truncation error (relative to the tolerances)
+      // The estimate needs u_dot from the last step, so the first step is not checked
+      bool check_error = adaptive_timestep && forward_times.size() > 1;
+      ScalarT err = 0.0;
+      if (status == 0 && check_error) {
+        err = this->estimateTimeError(u, u_last, u_dot_last, deltat);
+        if(Comm->getRank() == 0 && verbosity > 0) {
+          cout << "**** Time step error estimate: " << err << endl;
+        }
+      }
       
-      if (status == 0) { // NL solver converged
+      if (status == 0 && (err <= 1.0 || deltat <= dt_min)) { // NL solver converged and the step is accurate enough
         
-        // TMW: currently allowing storage of all solutions
-        // Need to implement some form of checkpointing
-        soln->store(u, current_time, 0);
-        soln_dot->store(u_dot, current_time, 0);
+        forward_times.push_back(current_time);
+        size_t step = forward_times.size()-1;
+        
+        // Either store every state or only the checkpoints (the rest are recomputed in the adjoint)
+        if (checkpoint_storage == 0 || this->haveCheckpoint(step)) {
+          soln->store(u, current_time, 0);
+          soln_dot->store(u_dot, current_time, 0);
+        }
         
         if (allow_remesh) {
           mesh->remesh(u, assembler->cells);
+          if (use_explicit) {
+            this->setupLumpedMass();
+          }
         }
         
         if (compute_objective) { // fill in the objective function
-          DFAD cobj = this->computeObjective(u, current_time, soln->times[0].size()-1);
+          DFAD cobj = this->computeObjective(u, current_time, step);
           obj += cobj;
         }
         if (compute_aux_sensitivity) {
@@ -684,68 +871,84 @@ void solver::transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> &
         if (compute_flux) {
           
         }
+        
+        u_last->update(1.0, *u, 0.0);
+        u_dot_last->update(1.0, *u_dot, 0.0);
+        
+        if (check_error) {
+          deltat *= this->timeStepFactor(err, err_prev);
+          deltat = std::min(std::max(deltat, dt_min), dt_max);
+          err_prev = std::max(err, 1.0e-4);
+        }
+        
+        if (abs(current_time - end_time)>1.0e-12) {
+          this->updateMultiscale();
+        }
       }
-      else { // something went wrong, cut time step and try again
+      else { // something went wrong or the step was not accurate enough, go back and try a smaller step
+        multiscale_manager->eraseTime(current_time);
         current_time -= deltat;
-        deltat *= 0.5;
-        current_time += deltat;
-        numCuts += 1;
+        u->update(1.0, *u_last, 0.0);
+        u_dot->update(1.0, *u_dot_last, 0.0);
         
-        bool fnd = soln->extract(u, current_time);
-        if(Comm->getRank() == 0 && verbosity > 0) {
-          cout << endl << endl << "*******************************************************" << endl;
-          cout << endl << "**** Cutting Time Step " << endl;
-          cout << "**** Current time is " << current_time << endl << endl;
-          cout << "*******************************************************" << endl << endl << endl;
+        if (status != 0) {
+          deltat *= 0.5;
+          numCuts += 1;
+          if(Comm->getRank() == 0 && verbosity > 0) {
+            cout << endl << endl << "*******************************************************" << endl;
+            cout << endl << "**** Cutting Time Step " << endl;
+            cout << "**** Current time is " << current_time << endl << endl;
+            cout << "*******************************************************" << endl << endl << endl;
+          }
+        }
+        else {
+          deltat = std::max(deltat*std::max(0.2, dt_safety*std::pow(err,-0.5)), dt_min);
+          if(Comm->getRank() == 0 && verbosity > 0) {
+            cout << "**** Rejecting time step, new delta t is " << deltat << endl;
+          }
         }
       }
     }
+    
+    if (numCuts > maxCuts && Comm->getRank() == 0) {
+      cout << "**** Warning: the transient solver stopped at time " << current_time << " after " << maxCuts << " time step cuts" << endl;
+    }
+    
+    if (checkpoint_storage > 0) {
+      // drop the planned checkpoints that were never reached
+      size_t numsteps = forward_times.size()-1;
+      while (forward_checkpoints.size() > 0 && *(forward_checkpoints.rbegin()) > numsteps) {
+        forward_checkpoints.erase(std::prev(forward_checkpoints.end()));
+      }
+    }
   }
   else { // adjoint solve - fixed time stepping based on forward solve
+    TEUCHOS_TEST_FOR_EXCEPTION(use_rk_stages || use_explicit,std::runtime_error,"Error: the transient adjoint is only implemented for backward Euler, not for multi-stage or explicit Runge-Kutta methods");
     current_time = final_time;
     is_final_time = true;
     
-    vector_RCP u = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
-    vector_RCP u_prev = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
-    vector_RCP u_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
     vector_RCP phi = initial;
-    vector_RCP phi_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
-    phi_dot->putScalar(0.0);
-    
-    size_t numsteps = soln->times[0].size()-1;
     
-    for (size_t timeiter = 0; timeiter<numsteps; timeiter++) {
-      size_t cindex = numsteps-timeiter;
-      phi_dot->putScalar(0.0);
-      current_time = soln->times[0][cindex];
-      
-      if(Comm->getRank() == 0 && verbosity > 0) {
-        cout << endl << endl << "*******************************************************" << endl;
-        cout << endl << "**** Beginning Adjoint Time Step " << timeiter << endl;
-        cout << "**** Current time is " << current_time << endl << endl;
-        cout << "*******************************************************" << endl << endl << endl;
-      }
+    if (checkpoint_storage > 0) {
+      // recompute the forward states from the checkpoints as needed
+      size_t numsteps = forward_times.size()-1;
+      this->checkpointAdjoint(0, numsteps, phi, gradient, beta);
+    }
+    else {
+      vector_RCP u, u_prev;
+      size_t numsteps = soln->times[0].size()-1;
       
-      // TMW: this is specific to implicit Euler
-      // Needs to be generalized
-      // Also, need to implement checkpoint/recovery
-      bool fndu = soln->extract(u, cindex);
-      bool fndup = soln->extract(u_prev, cindex-1);
-      auto u_kv = u->getLocalView<HostDevice>();
-      auto u_prev_kv = u_prev->getLocalView<HostDevice>();
-      auto u_dot_kv = u_dot->getLocalView<HostDevice>();
-      for( size_t i=0; i<LA_ownedAndShared.size(); i++ ) {
-        u_dot_kv(i,0) = alpha*u_kv(i,0) - alpha*u_prev_kv(i,0);
+      for (size_t timeiter = 0; timeiter<numsteps; timeiter++) {
+        size_t cindex = numsteps-timeiter;
+        current_time = soln->times[0][cindex];
+        
+        // TMW: this is specific to implicit Euler
+        // Needs to be generalized
+        bool fndu = soln->extract(u, cindex);
+        bool fndup = soln->extract(u_prev, cindex-1);
+        alpha = this->timeStepAlpha(soln->times[0][cindex] - soln->times[0][cindex-1]);
+        this->adjointTimeStep(timeiter, u, u_prev, phi, gradient, alpha, beta);
       }
-      int status = this->nonlinearSolver(u, u_dot, phi, phi_dot, alpha, beta);
-      
-      // Storing the adjoint solution should be made optional
-      // We are computing the sensitivities as we go, so storage isn't always necessary
-      adj_soln->store(phi,current_time,0);
-      
-      this->computeSensitivities(u,u_dot,phi,gradient,alpha,beta);
-      
-      is_final_time = false;
     }
   }
   
@@ -757,6 +960,415 @@ void solver::transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> &
   
 }
 
+// ========================================================================================
+/* one step of a diagonally implicit RK method from prev_time to current_time
+   u_prev is the solution at prev_time
+   Each stage solves R(U_s,K_s) = 0 with U_s = base_s + dt*a_ss*K_s using the nonlinear solver,
+   which updates U_s and K_s together (alpha = 1/(a_ss*dt)) */
+// ========================================================================================
+
+int solver::rungeKuttaStep(vector_RCP & u, vector_RCP & u_dot, vector_RCP & u_prev,
+                           const ScalarT & prev_time, const ScalarT & beta) {
+  
+  Teuchos::TimeMonitor localtimer(*rksteptimer);
+  
+  ScalarT end_time = current_time;
+  ScalarT dt = current_time - prev_time;
+  size_t nstages = timeInt->num_stages;
+  
+  if (stage_u_dot.size() != nstages) {
+    stage_u_dot.clear();
+    for (size_t s=0; s<nstages; s++) {
+      stage_u_dot.push_back(Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1)));
+    }
+  }
+  vector_RCP zero_vec = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  zero_vec->putScalar(0.0);
+  
+  int status = 0;
+  for (size_t s=0; s<nstages; s++) {
+    current_time = timeInt->computeTime(prev_time, s, dt);
+    timeInt->computeStageBase(u_prev, stage_u_dot, s, dt, u);
+    u_dot->putScalar(0.0);
+    ScalarT alpha = timeInt->computeStageAlpha(s, dt);
+    
+    if(Comm->getRank() == 0 && verbosity > 1) {
+      cout << "**** Runge-Kutta stage " << s << " at time " << current_time << endl;
+    }
+    
+    status = this->nonlinearSolver(u, u_dot, zero_vec, zero_vec, alpha, beta);
+    stage_u_dot[s]->update(1.0, *u_dot, 0.0);
+    if (status != 0) {
+      break;
+    }
+  }
+  current_time = end_time;
+  
+  // For stiffly accurate methods the last stage is already the solution
+  // u_dot is left as the time derivative at the last stage
+  if (status == 0 && !timeInt->isStifflyAccurate()) {
+    timeInt->computeSolution(u_prev, stage_u_dot, dt, u);
+    if (usestrongDBCs) {
+      this->setDirichlet(u);
+    }
+  }
+  return status;
+}
+
+// ========================================================================================
+/* inverse of the lumped mass matrix and the smallest element size */
+// ========================================================================================
+
+void solver::setupLumpedMass() {
+  
+  vector_RCP mass_over = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  mass_over->putScalar(0.0);
+  ScalarT my_hmin = 0.0;
+  assembler->getLumpedMass(mass_over, my_hmin);
+  Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MIN,1,&my_hmin,&mesh_hmin);
+  
+  lumped_mass_inv = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  lumped_mass_inv->putScalar(0.0);
+  lumped_mass_inv->doExport(*mass_over, *exporter, Tpetra::ADD);
+  lumped_mass_inv->reciprocal(*lumped_mass_inv);
+}
+
+// ========================================================================================
+/* one step of an explicit RK method from prev_time to current_time
+   Only residuals are assembled: the stage time derivative is K_s = M_L^{-1}*res(U_s,0)
+   since the assembled residual is -R(u,u_dot) and R is M*u_dot + F(u) for these physics */
+// ========================================================================================
+
+int solver::explicitStep(vector_RCP & u, vector_RCP & u_dot, vector_RCP & u_prev,
+                         const ScalarT & prev_time) {
+  
+  Teuchos::TimeMonitor localtimer(*explicitsteptimer);
+  
+  ScalarT end_time = current_time;
+  ScalarT dt = current_time - prev_time;
+  size_t nstages = timeInt->num_stages;
+  
+  if (stage_u_dot.size() != nstages) {
+    stage_u_dot.clear();
+    for (size_t s=0; s<nstages; s++) {
+      stage_u_dot.push_back(Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1)));
+    }
+  }
+  vector_RCP zero_vec = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  zero_vec->putScalar(0.0);
+  vector_RCP K = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  
+  for (size_t s=0; s<nstages; s++) {
+    current_time = timeInt->computeTime(prev_time, s, dt);
+    timeInt->computeStageBase(u_prev, stage_u_dot, s, dt, u);
+    if (usestrongDBCs) {
+      this->setDirichlet(u);
+    }
+    
+    multiscale_manager->reset();
+    res_over->putScalar(0.0);
+    assembler->assembleJacRes(u, zero_vec, zero_vec, zero_vec, 0.0, 1.0, false, false, false,
+                              res_over, J_over, isTransient, current_time, false, false,
+                              params->num_active_params, params->Psol[0], is_final_time);
+    res->putScalar(0.0);
+    res->doExport(*res_over, *exporter, Tpetra::ADD);
+    
+    K->elementWiseMultiply(1.0, *(lumped_mass_inv->getVector(0)), *res, 0.0);
+    stage_u_dot[s]->putScalar(0.0);
+    stage_u_dot[s]->doImport(*K, *importer, Tpetra::ADD);
+  }
+  current_time = end_time;
+  
+  timeInt->computeSolution(u_prev, stage_u_dot, dt, u);
+  if (usestrongDBCs) {
+    this->setDirichlet(u);
+  }
+  u_dot->update(1.0/dt, *u, -1.0/dt, *u_prev, 0.0);
+  
+  return 0;
+}
+
+// ========================================================================================
+/* coefficient on u_dot for a time step of size dt */
+// ========================================================================================
+
+ScalarT solver::timeStepAlpha(const ScalarT & dt) {
+  ScalarT alpha = 0.0;
+  if (time_order == 1){
+    alpha = 1./dt;
+  }
+  else if (time_order == 2) {
+    alpha = 3.0/2.0/dt;
+  }
+  else {
+    alpha = 0.0; // would be better to print out an error message
+  }
+  return alpha;
+}
+
+// ========================================================================================
+/* local truncation error estimate for implicit Euler, scaled by the tolerances (accept if <= 1)
+   Compares the solution with the explicit Euler predictor, so LTE ~ (u - u_last - dt*u_dot_last)/2 */
+// ========================================================================================
+
+ScalarT solver::estimateTimeError(vector_RCP & u, vector_RCP & u_last, vector_RCP & u_dot_last,
+                                  const ScalarT & dt) {
+  
+  vector_RCP diff_over = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  diff_over->update(1.0, *u, -1.0, *u_last, 0.0);
+  diff_over->update(-dt, *u_dot_last, 1.0);
+  
+  vector_RCP diff = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  vector_RCP u_owned = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
+  diff->doExport(*diff_over, *exporter, Tpetra::REPLACE);
+  u_owned->doExport(*u, *exporter, Tpetra::REPLACE);
+  
+  Teuchos::Array<typename Teuchos::ScalarTraits<ScalarT>::magnitudeType> diffnorm(1), unorm(1);
+  diff->norm2(diffnorm);
+  u_owned->norm2(unorm);
+  ScalarT N = std::max((ScalarT)diff->getGlobalLength(), 1.0);
+  ScalarT err = 0.5*diffnorm[0]/std::sqrt(N);
+  ScalarT scale = dt_tol_abs + dt_tol_rel*unorm[0]/std::sqrt(N);
+  return err/scale;
+}
+
+// ========================================================================================
+/* PI step size controller (Gustafsson): dt_new = dt * safety * err^(-0.7/k) * err_prev^(0.4/k) */
+// ========================================================================================
+
+ScalarT solver::timeStepFactor(const ScalarT & err, const ScalarT & err_prev) {
+  ScalarT k = 2.0; // order of the error estimate + 1
+  ScalarT factor = dt_growth;
+  if (err > 0.0) {
+    factor = dt_safety*std::pow(err,-0.7/k)*std::pow(err_prev,0.4/k);
+  }
+  return std::min(std::max(factor, 0.2), dt_growth);
+}
+
+// ========================================================================================
+// Allow the cells to change subgrid model (and move the subgrid solves between ranks)
+// ========================================================================================
+
+void solver::updateMultiscale() {
+  Teuchos::TimeMonitor localtimer(*msprojtimer);
+  ScalarT my_cost = multiscale_manager->update();
+  ScalarT gmin = 0.0;
+  Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MIN,1,&my_cost,&gmin);
+  ScalarT gmax = 0.0;
+  Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MAX,1,&my_cost,&gmax);
+  if(Comm->getRank() == 0 && verbosity>0 && gmin > 0.0) {
+    cout << "***** Load Balancing Factor " << gmax/gmin <<  endl;
+  }
+}
+
+// ========================================================================================
+/* one adjoint time step (implicit Euler) at current_time */
+// ========================================================================================
+
+void solver::adjointTimeStep(const size_t & timeiter, vector_RCP & u, vector_RCP & u_prev, vector_RCP & phi,
+                             vector<ScalarT> & gradient, const ScalarT & alpha, const ScalarT & beta) {
+  
+  if(Comm->getRank() == 0 && verbosity > 0) {
+    cout << endl << endl << "*******************************************************" << endl;
+    cout << endl << "**** Beginning Adjoint Time Step " << timeiter << endl;
+    cout << "**** Current time is " << current_time << endl << endl;
+    cout << "*******************************************************" << endl << endl << endl;
+  }
+  
+  vector_RCP u_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  vector_RCP phi_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  phi_dot->putScalar(0.0);
+  
+  auto u_kv = u->getLocalView<HostDevice>();
+  auto u_prev_kv = u_prev->getLocalView<HostDevice>();
+  auto u_dot_kv = u_dot->getLocalView<HostDevice>();
+  for( size_t i=0; i<LA_ownedAndShared.size(); i++ ) {
+    u_dot_kv(i,0) = alpha*u_kv(i,0) - alpha*u_prev_kv(i,0);
+  }
+  int status = this->nonlinearSolver(u, u_dot, phi, phi_dot, alpha, beta);
+  
+  // Storing the adjoint solution should be made optional
+  // We are computing the sensitivities as we go, so storage isn't always necessary
+  adj_soln->store(phi,current_time,0);
+  
+  this->computeSensitivities(u,u_dot,phi,gradient,alpha,beta);
+  
+  is_final_time = false;
+}
+
+// ========================================================================================
+/* Binomial (revolve) checkpointing for the transient adjoint
+   The forward solve only stores the initial state and checkpoint_storage other states
+   The adjoint sweep recursively recomputes the states between checkpoints, reusing the
+   free checkpoints as it goes, so the number of recomputed steps grows like log(numsteps) */
+// ========================================================================================
+
+void solver::setForwardCheckpoints(const size_t & nsteps) {
+  forward_checkpoints.clear();
+  size_t s = 0;
+  int numfree = checkpoint_storage;
+  while (numfree > 0 && nsteps > s+1) {
+    s = this->checkpointSplit(s, nsteps, numfree);
+    forward_checkpoints.insert(s);
+    numfree--;
+  }
+}
+
+// ========================================================================================
+// ========================================================================================
+
+size_t solver::checkpointSplit(const size_t & s, const size_t & e, const int & numfree) {
+  // Position of the next checkpoint in (s,e) given numfree free checkpoints
+  // Find the smallest number of sweeps r such that C(c+r,c) >= e-s and place
+  // the checkpoint so the remaining interval can be reversed with c-1 checkpoints and r sweeps
+  size_t len = e-s;
+  if (len < 2 || numfree < 1) {
+    return s+1;
+  }
+  size_t c = numfree;
+  size_t r = 0;
+  ScalarT binom = 1.0; // C(c+r,c)
+  while (binom < (ScalarT)len) {
+    r++;
+    binom *= (ScalarT)(c+r)/(ScalarT)r;
+  }
+  // C(c-1+r,c-1) = C(c+r,c)*c/(c+r)
+  ScalarT right = binom*(ScalarT)c/(ScalarT)(c+r);
+  size_t shift = 1;
+  if ((ScalarT)len - right > 1.0) {
+    shift = (size_t)std::floor((ScalarT)len - right + 1.0e-8);
+  }
+  size_t m = std::min(s+shift, e-1);
+  return m;
+}
+
+// ========================================================================================
+// ========================================================================================
+
+bool solver::haveCheckpoint(const size_t & step) {
+  return (step == 0 || forward_checkpoints.count(step) > 0);
+}
+
+int solver::numCheckpoints() {
+  return forward_checkpoints.size();
+}
+
+// ========================================================================================
+/* recompute the forward state at step e starting from the stored state at step s */
+// ========================================================================================
+
+void solver::recomputeForward(vector_RCP & u, const size_t & s, const size_t & e,
+                              const ScalarT & beta) {
+  
+  vector_RCP u_s;
+  bool fnd = soln->extract(u_s, 0, forward_times[s]);
+  TEUCHOS_TEST_FOR_EXCEPTION(!fnd,std::runtime_error,"Error: MILO could not find the checkpoint at time " + std::to_string(forward_times[s]));
+  u->update(1.0, *u_s, 0.0);
+  
+  vector_RCP u_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  for (size_t i=s+1; i<=e; i++) {
+    this->recomputeStep(u, u_dot, i, beta);
+  }
+  if (e > s && this->haveCheckpoint(e)) { // keep soln_dot consistent with soln for the checkpoints
+    soln_dot->store(u_dot, forward_times[e], 0);
+  }
+}
+
+// ========================================================================================
+/* repeat forward step i (u is the state at step i-1 on input) */
+// ========================================================================================
+
+void solver::recomputeStep(vector_RCP & u, vector_RCP & u_dot, const size_t & i,
+                           const ScalarT & beta) {
+  
+  Teuchos::TimeMonitor localtimer(*recomputetimer);
+  
+  bool save_adjoint = useadjoint;
+  bool save_final = is_final_time;
+  ScalarT save_time = current_time;
+  useadjoint = false;
+  is_final_time = false;
+  current_time = forward_times[i];
+  
+  if(Comm->getRank() == 0 && verbosity > 5) {
+    cout << "**** Recomputing forward state at time " << current_time << endl;
+  }
+  
+  // Same as the forward step: the subgrid models are updated before the solve
+  this->updateMultiscale();
+  
+  vector_RCP zero_vec = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+  zero_vec->putScalar(0.0);
+  u_dot->putScalar(0.0);
+  ScalarT alpha = this->timeStepAlpha(forward_times[i] - forward_times[i-1]);
+  int status = this->nonlinearSolver(u, u_dot, zero_vec, zero_vec, alpha, beta);
+  
+  useadjoint = save_adjoint;
+  is_final_time = save_final;
+  current_time = save_time;
+}
+
+// ========================================================================================
+/* adjoint sweep over steps e,e-1,...,s+1 assuming the state at step s is stored */
+// ========================================================================================
+
+void solver::checkpointAdjoint(const size_t & s, const size_t & e, vector_RCP & phi, vector<ScalarT> & gradient,
+                               const ScalarT & beta) {
+  
+  if (e <= s) {
+    return;
+  }
+  
+  size_t numsteps = forward_times.size()-1;
+  
+  // last checkpoint in (s,e)
+  size_t m = s;
+  for (std::set<size_t>::iterator it=forward_checkpoints.begin(); it!=forward_checkpoints.end(); ++it) {
+    if (*it > s && *it < e) {
+      m = *it;
+    }
+  }
+  
+  // place a new checkpoint if one is free
+  if (m == s && e-s > 1 && this->numCheckpoints() < checkpoint_storage) {
+    m = this->checkpointSplit(s, e, checkpoint_storage - this->numCheckpoints());
+    forward_checkpoints.insert(m);
+    vector_RCP u_m = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    this->recomputeForward(u_m, s, m, beta);
+    soln->store(u_m, forward_times[m], 0);
+  }
+  
+  if (m > s) {
+    this->checkpointAdjoint(m, e, phi, gradient, beta);
+    
+    // free the checkpoint for the rest of the sweep
+    soln->erase(0, forward_times[m]);
+    soln_dot->erase(0, forward_times[m]);
+    forward_checkpoints.erase(m);
+    
+    this->checkpointAdjoint(s, m, phi, gradient, beta);
+  }
+  else {
+    // no free checkpoints, so recompute each state from s
+    vector_RCP u = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    vector_RCP u_prev = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    vector_RCP u_dot = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
+    for (size_t i=e; i>s; i--) {
+      this->recomputeForward(u_prev, s, i-1, beta);
+      if (this->haveCheckpoint(i)) {
+        this->recomputeForward(u, i, i, beta);
+      }
+      else {
+        u->update(1.0, *u_prev, 0.0);
+        this->recomputeStep(u, u_dot, i, beta);
+      }
+      current_time = forward_times[i];
+      ScalarT alpha = this->timeStepAlpha(forward_times[i] - forward_times[i-1]);
+      this->adjointTimeStep(numsteps-i, u, u_prev, phi, gradient, alpha, beta);
+    }
+  }
+}
+
 // ========================================================================================
 // ========================================================================================
 
@@ -790,25 +1402,40 @@ int solver::nonlinearSolver(vector_RCP & u, vector_RCP & u_dot,
     maxiter = 2;
   }
   
+  ScalarT eta = ew_eta0;
+  ScalarT prev_norm = 0.0;
+  
+  // J is reused across solves, but a factorization or preconditioner built for the
+  // forward problem or another alpha (time step or stage) is for a different matrix
+  if (useadjoint != reuse_adjoint || std::abs(alpha - reuse_alpha) > 1.0e-12*std::max(1.0,std::abs(alpha))) {
+    factor_matrix = NULL;
+    prec_matrix = NULL;
+    rebuild_prec = true;
+    reuse_adjoint = useadjoint;
+    reuse_alpha = alpha;
+  }
+  
   while( NLerr_scaled[0]>NLtol && NLiter<maxiter ) { // while not converged
     
     multiscale_manager->reset();
     
     gNLiter = NLiter;
     
-    vector_RCP res = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
-    matrix_RCP J = Tpetra::createCrsMatrix<ScalarT>(LA_owned_map);
-    vector_RCP res_over = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
-    matrix_RCP J_over = Teuchos::rcp(new Tpetra::CrsMatrix<ScalarT,LO,GO,HostNode>(LA_overlapped_graph));
-    vector_RCP du = Teuchos::rcp(new LA_MultiVector(LA_overlapped_map,1));
-    vector_RCP du_over = Teuchos::rcp(new LA_MultiVector(LA_owned_map,1));
-    
     // *********************** COMPUTE THE JACOBIAN AND THE RESIDUAL **************************
     
     bool build_jacobian = true;
+    bool matrix_free = use_matrix_free && !useadjoint;
+    if (matrix_free) {
+      // the Jacobian is only needed for the preconditioner, so it is lagged
+      build_jacobian = (mf_lag_num == 0);
+      mf_lag_num = (mf_lag_num+1) % mf_prec_lag;
+    }
     
     res_over->putScalar(0.0);
-    J_over->setAllToScalar(0.0);
+    if (build_jacobian) {
+      J_over->resumeFill();
+      J_over->setAllToScalar(0.0);
+    }
     if ( useadjoint && (NLiter == 1))
       store_adjPrev = true;
     else
@@ -817,11 +1444,17 @@ int solver::nonlinearSolver(vector_RCP & u, vector_RCP & u_dot,
     assembler->assembleJacRes(u, u_dot, phi, phi_dot, alpha, beta, build_jacobian, false, false,
                               res_over, J_over, isTransient, current_time, useadjoint, store_adjPrev,
                               params->num_active_params, params->Psol[0], is_final_time);
-    J_over->fillComplete();
-    
-    J->setAllToScalar(0.0);
-    J->doExport(*J_over, *exporter, Tpetra::ADD);
-    J->fillComplete();
+    if (build_jacobian) {
+      J_over->fillComplete();
+      
+      J->resumeFill();
+      J->setAllToScalar(0.0);
+      J->doExport(*J_over, *exporter, Tpetra::ADD);
+      J->fillComplete();
+      if (matrix_free) {
+        rebuild_prec = true;
+      }
+    }
     
     res->putScalar(0.0);
     res->doExport(*res_over, *exporter, Tpetra::ADD);
@@ -855,14 +1488,53 @@ int solver::nonlinearSolver(vector_RCP & u, vector_RCP & u_dot,
     
     if (NLerr_scaled[0] > NLtol && useLinearSolver) {
       
-      this->linearSolver(J, res, du_over);
+      // Inexact Newton: solve the linear system only as accurately as the nonlinear residual warrants
+      ScalarT curr_norm = (NLiter == 0) ? NLerr_first[0] : NLerr[0];
+      if (use_eisenstat_walker && !useadjoint) {
+        if (NLiter > 0 && prev_norm > 0.0) {
+          ScalarT eta_prev = eta;
+          eta = ew_gamma*(curr_norm/prev_norm)*(curr_norm/prev_norm);
+          if (ew_gamma*eta_prev*eta_prev > 0.1) { // safeguard against oversolving too early
+            eta = std::max(eta, ew_gamma*eta_prev*eta_prev);
+          }
+        }
+        eta = std::min(eta, ew_eta_max);
+        lintol_current = std::max(eta, lintol);
+        if(Comm->getRank() == 0 && verbosity > 5) {
+          cout << "***** Linear solver tolerance: " << lintol_current << endl;
+        }
+      }
+      prev_norm = curr_norm;
+      
+      du_over->putScalar(0.0);
+      if (matrix_free) {
+        mf_J->alpha = alpha;
+        if (mf_J->use_fd) {
+          // residual only (no Jacobian) at the perturbed state
+          mf_J->setState(u, u_dot, res_over);
+          mf_J->residual = [&](vector_RCP & u_p, vector_RCP & u_dot_p, vector_RCP & res_p) {
+            assembler->assembleJacRes(u_p, u_dot_p, phi, phi_dot, alpha, beta, false, false, false,
+                                      res_p, J_over, isTransient, current_time, false, false,
+                                      params->num_active_params, params->Psol[0], is_final_time);
+          };
+        }
+        this->linearSolver(J, res, du_over, mf_J);
+        mf_J->residual = nullptr;
+      }
+      else {
+        this->linearSolver(J, res, du_over);
+      }
       
+      du->putScalar(0.0);
       du->doImport(*du_over, *importer, Tpetra::ADD);
       
       if (useadjoint) {
         phi->update(1.0, *du, 1.0);
         phi_dot->update(alpha, *du, 1.0);
       }
+      else if (line_search) {
+        this->lineSearch(u, u_dot, phi, phi_dot, alpha, beta);
+      }
       else {
         u->update(1.0, *du, 1.0);
         u_dot->update(alpha, *du, 1.0);
@@ -872,6 +1544,8 @@ int solver::nonlinearSolver(vector_RCP & u, vector_RCP & u_dot,
     NLiter++; // increment number of iterations
   } // while loop
   
+  lintol_current = lintol;
+  
   if(Comm->getRank() == 0) {
     if (!useadjoint) {
       if( (NLiter>MaxNLiter || NLerr_scaled[0]>NLtol) && verbosity > 1) {
@@ -891,6 +1565,59 @@ int solver::nonlinearSolver(vector_RCP & u, vector_RCP & u_dot,
   return status;
 }
 
+// ========================================================================================
+/* backtracking line search along the Newton direction du
+   Uses residual-only assembly and a quadratic model of ||res||^2 (steps kept in [0.1,0.5]
+   of the previous step) until the Armijo condition ||res(u+lambda*du)|| <= (1-c*lambda)||res(u)|| holds */
+// ========================================================================================
+
+void solver::lineSearch(vector_RCP & u, vector_RCP & u_dot, vector_RCP & phi, vector_RCP & phi_dot,
+                        const ScalarT & alpha, const ScalarT & beta) {
+  
+  Teuchos::TimeMonitor localtimer(*linesearchtimer);
+  
+  Teuchos::Array<typename Teuchos::ScalarTraits<ScalarT>::magnitudeType> resnorm(1);
+  res->norm2(resnorm);
+  ScalarT f0 = resnorm[0];
+  
+  ScalarT lambda = 1.0;
+  u->update(lambda, *du, 1.0);
+  u_dot->update(alpha*lambda, *du, 1.0);
+  
+  for (int k=0; k<ls_max_backtracks; k++) {
+    
+    multiscale_manager->reset();
+    res_over->putScalar(0.0);
+    assembler->assembleJacRes(u, u_dot, phi, phi_dot, alpha, beta, false, false, false,
+                              res_over, J_over, isTransient, current_time, false, false,
+                              params->num_active_params, params->Psol[0], is_final_time);
+    res->putScalar(0.0);
+    res->doExport(*res_over, *exporter, Tpetra::ADD);
+    res->norm2(resnorm);
+    ScalarT f1 = resnorm[0];
+    
+    if (f1 <= (1.0 - ls_decrease*lambda)*f0) {
+      break;
+    }
+    
+    // minimizer of the quadratic through |res|^2 at 0 and lambda (slope -f0^2 at 0)
+    ScalarT denom = 2.0*(f1*f1 - f0*f0 + 2.0*lambda*f0*f0);
+    ScalarT lambda_new = 0.5*lambda;
+    if (denom > 0.0) {
+      lambda_new = 2.0*lambda*lambda*f0*f0/denom;
+    }
+    lambda_new = std::min(std::max(lambda_new, 0.1*lambda), 0.5*lambda);
+    
+    if(Comm->getRank() == 0 && verbosity > 1) {
+      cout << "***** Line search: residual norm " << f1 << ", reducing step to " << lambda_new << endl;
+    }
+    
+    u->update(lambda_new - lambda, *du, 1.0);
+    u_dot->update(alpha*(lambda_new - lambda), *du, 1.0);
+    lambda = lambda_new;
+  }
+}
+
 // ========================================================================================
 // ========================================================================================
 
@@ -1349,31 +2076,121 @@ vector_RCP solver::setInitial() {
 // ========================================================================================
 
 void solver::linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln)  {
+  this->linearSolver(J, r, soln, J);
+}
+
+// ========================================================================================
+// ========================================================================================
+
+void solver::linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln,
+                          const Teuchos::RCP<LA_Operator> & A)  {
   Teuchos::TimeMonitor localtimer(*linearsolvertimer);
   
+  bool matrix_free = (A.get() != J.get());
+  
   if (useDirect) {
-    if (have_symbolic_factor) {
-      Am2Solver->setA(J, Amesos2::SYMBFACT);
+    // The numeric factorization may be reused for a fixed number of solves with the same matrix
+    // (this turns Newton's method into a modified Newton method)
+    if (have_symbolic_factor && factor_matrix == J.get() && factor_reuse_num < factor_reuse_max) {
       Am2Solver->setX(soln);
       Am2Solver->setB(r);
+      Am2Solver->solve();
+      factor_reuse_num++;
     }
     else {
-      Am2Solver = Amesos2::create<LA_CrsMatrix,LA_MultiVector>("KLU2", J, r, soln);
-      Am2Solver->symbolicFactorization();
-      have_symbolic_factor = true;
+      if (have_symbolic_factor) {
+        Am2Solver->setA(J, Amesos2::SYMBFACT);
+        Am2Solver->setX(soln);
+        Am2Solver->setB(r);
+      }
+      else {
+        Am2Solver = Amesos2::create<LA_CrsMatrix,LA_MultiVector>("KLU2", J, r, soln);
+        Am2Solver->symbolicFactorization();
+        have_symbolic_factor = true;
+      }
+      Am2Solver->numericFactorization().solve();
+      factor_matrix = J.get();
+      factor_reuse_num = 0;
     }
-    Am2Solver->numericFactorization().solve();
   }
   else {
-    Teuchos::RCP<LA_LinearProblem> Problem = Teuchos::rcp(new LA_LinearProblem(J, soln, r));
-    Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > M = buildPreconditioner(J);
+    Teuchos::RCP<LA_LinearProblem> Problem = Teuchos::rcp(new LA_LinearProblem(A, soln, r));
+    
+    // The preconditioner is always rebuilt if the matrix object changes (e.g., the mass matrix
+    // for the L2-projections) or after prec_reuse_max solves
+    // With a matrix-free operator, the preconditioner is rebuilt when J is reassembled
+    // The block preconditioner is built on the owned Jacobian only (other matrices use AMG) and
+    // is either rebuilt or fully reused
+    bool use_block = (prec_type == "block" && J.get() == this->J.get());
+    Teuchos::RCP<LA_Operator> prec;
+    if (use_block) {
+      if ((prec_reuse_type != "full" && !matrix_free) || prec_matrix != J.get() ||
+          rebuild_prec || prec_reuse_num >= prec_reuse_max) {
+        Teuchos::TimeMonitor localtimer(*precsetuptimer);
+        blockM->setup(J);
+        prec_matrix = J.get();
+        prec_reuse_num = 0;
+        rebuild_prec = false;
+      }
+      else {
+        prec_reuse_num++;
+      }
+      prec = blockM;
+    }
+#ifdef MILO_HAVE_SINGLE_PRECISION
+    else if (prec_precision == "single") {
+      if ((prec_reuse_type == "none" && !matrix_free) || M_sp == Teuchos::null || prec_matrix != J.get() ||
+          rebuild_prec || prec_reuse_num >= prec_reuse_max) {
+        Teuchos::TimeMonitor localtimer(*precsetuptimer);
+        Teuchos::ParameterList mueluParams = this->getMueLuParams();
+        M_sp = Teuchos::rcp(new SinglePrecisionPreconditioner(J, mueluParams));
+        prec_matrix = J.get();
+        prec_reuse_num = 0;
+        rebuild_prec = false;
+      }
+      else {
+        if (prec_reuse_type != "full") {
+          Teuchos::TimeMonitor localtimer(*precsetuptimer);
+          M_sp->reuse(J);
+        }
+        prec_reuse_num++;
+      }
+      prec = M_sp;
+    }
+#endif
+    else {
+      if ((prec_reuse_type == "none" && !matrix_free) || M == Teuchos::null || prec_matrix != J.get() ||
+          rebuild_prec || prec_reuse_num >= prec_reuse_max) {
+        Teuchos::TimeMonitor localtimer(*precsetuptimer);
+        M = buildPreconditioner(J);
+        prec_matrix = J.get();
+        prec_reuse_num = 0;
+        rebuild_prec = false;
+      }
+      else {
+        if (prec_reuse_type != "full") {
+          Teuchos::TimeMonitor localtimer(*precsetuptimer);
+          MueLu::ReuseTpetraPreconditioner(J, *M);
+        }
+        prec_reuse_num++;
+      }
+      prec = M;
+    }
+    
+    // A single precision preconditioner is not exactly a fixed operator in double precision,
+    // so it is applied on the right with flexible GMRES
+    if (prec_precision == "single") {
+      Problem->setRightPrec(prec);
+    }
+    else {
+      Problem->setLeftPrec(prec);
+    }
     
-    Problem->setLeftPrec(M);
     Problem->setProblem();
     
     Teuchos::RCP<Teuchos::ParameterList> belosList = Teuchos::rcp(new Teuchos::ParameterList());
     belosList->set("Maximum Iterations",    kspace); // Maximum number of iterations allowed
-    belosList->set("Convergence Tolerance", lintol);    // Relative convergence tolerance requested
+    belosList->set("Convergence Tolerance", lintol_current);    // Relative convergence tolerance requested
     if (verbosity > 9) {
       belosList->set("Verbosity", Belos::Errors + Belos::Warnings + Belos::StatusTestDetails);
     }
@@ -1392,12 +2209,120 @@ void solver::linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln)  {
     }
     belosList->set("number of equations",numEqns);
     
+    if (prec_precision == "single") {
+      belosList->set("Flexible Gmres", true);
+    }
+    
     belosList->set("Output Style",          Belos::Brief);
     belosList->set("Implicit Residual Scaling", "None");
     
     Teuchos::RCP<Belos::SolverManager<ScalarT, LA_MultiVector, LA_Operator> > solver = Teuchos::rcp(new Belos::BlockGmresSolMgr<ScalarT, LA_MultiVector, LA_Operator>(Problem, belosList));
     
     solver->solve();
+    
+    // Rebuild the preconditioner on the next solve if it has degraded too much
+    int numiters = solver->getNumIters();
+    if (prec_rebuild_iters > 0 && numiters > prec_rebuild_iters) {
+      rebuild_prec = true;
+    }
+    if (verbosity > 5 && Comm->getRank() == 0) {
+      cout << "        Linear solver iterations: " << numiters << endl;
+    }
+  }
+}
+
+// ========================================================================================
+// Field-split preconditioner (the splits are groups of variables, by name)
+// ========================================================================================
+
+void solver::setupBlockPreconditioner() {
+  
+  // Parse the splits, e.g., "ux,uy;pr" (default is one split per variable)
+  vector<vector<string> > splits;
+  if (block_splits == "") {
+    for (size_t b=0; b<varlist.size(); b++) {
+      for (size_t n=0; n<varlist[b].size(); n++) {
+        bool found = false;
+        for (size_t k=0; k<splits.size(); k++) {
+          if (splits[k][0] == varlist[b][n]) {
+            found = true;
+          }
+        }
+        if (!found) {
+          splits.push_back(vector<string>(1,varlist[b][n]));
+        }
+      }
+    }
+  }
+  else {
+    std::stringstream ss(block_splits);
+    string splitstr;
+    while (std::getline(ss, splitstr, ';')) {
+      std::stringstream vs(splitstr);
+      string var;
+      vector<string> currsplit;
+      while (std::getline(vs, var, ',')) {
+        var.erase(std::remove(var.begin(), var.end(), ' '), var.end());
+        if (var != "") {
+          currsplit.push_back(var);
+        }
+      }
+      if (currsplit.size() > 0) {
+        splits.push_back(currsplit);
+      }
+    }
+  }
+  
+  // Split of each variable on each block
+  vector<vector<int> > var_split(varlist.size());
+  for (size_t b=0; b<varlist.size(); b++) {
+    for (size_t n=0; n<varlist[b].size(); n++) {
+      int sindex = -1;
+      for (size_t k=0; k<splits.size(); k++) {
+        for (size_t j=0; j<splits[k].size(); j++) {
+          if (splits[k][j] == varlist[b][n]) {
+            sindex = k;
+          }
+        }
+      }
+      TEUCHOS_TEST_FOR_EXCEPTION(sindex < 0,std::runtime_error,"Error: the variable " + varlist[b][n] + " is not in any of the block splits");
+      var_split[b].push_back(sindex);
+    }
+  }
+  
+  // Split of each owned unknown
+  vector<int> owned_split(LA_owned_map->getNodeNumElements(),-1);
+  for (size_t b=0; b<assembler->cells.size(); b++) {
+    vector<vector<int> > curroffsets = phys->offsets[b];
+    for (size_t e=0; e<assembler->cells[b].size(); e++) {
+      Kokkos::View<GO**,HostDevice> gids = assembler->cells[b][e]->GIDs;
+      for (int p=0; p<assembler->cells[b][e]->numElem; p++) {
+        for (int n=0; n<numVars[b]; n++) {
+          for (int i=0; i<numBasis[b][n]; i++) {
+            LO lid = LA_owned_map->getLocalElement(gids(p,curroffsets[n][i]));
+            if (lid != Teuchos::OrdinalTraits<LO>::invalid()) {
+              owned_split[lid] = var_split[b][n];
+            }
+          }
+        }
+      }
+    }
+  }
+  
+  BlockPreconditioner::subprec_builder builder = [this](const matrix_RCP & A) {
+#ifdef MILO_HAVE_SINGLE_PRECISION
+    if (prec_precision == "single") {
+      Teuchos::ParameterList mueluParams = this->getMueLuParams();
+      return Teuchos::rcp_implicit_cast<LA_Operator>(Teuchos::rcp(new SinglePrecisionPreconditioner(A, mueluParams)));
+    }
+#endif
+    return Teuchos::rcp_implicit_cast<LA_Operator>(this->buildPreconditioner(A));
+  };
+  blockM = Teuchos::rcp(new BlockPreconditioner(LA_owned_map, owned_split, splits.size(),
+                                                block_prec_type, schur_type, builder));
+  
+  if (verbosity > 0 && Comm->getRank() == 0) {
+    cout << "**** Using a block preconditioner with " << splits.size() << " splits" << endl;
   }
 }
 
@@ -1406,6 +2331,18 @@ void solver::linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln)  {
 // ========================================================================================
 
 Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > solver::buildPreconditioner(const matrix_RCP & J) {
+  Teuchos::ParameterList mueluParams = this->getMueLuParams();
+  
+  Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > M = MueLu::CreateTpetraPreconditioner((Teuchos::RCP<LA_Operator>)J, mueluParams);
+
+  return M;
+}
+
+// ========================================================================================
+// MueLu settings (shared by the double and single precision preconditioners)
+// ========================================================================================
+
+Teuchos::ParameterList solver::getMueLuParams() {
   Teuchos::ParameterList mueluParams;
   
   mueluParams.setName("MueLu");
@@ -1452,9 +2389,12 @@ Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > solver::buildPre
   mueluParams.set("repartition: max imbalance", 1.1);
   mueluParams.set("repartition: remap parts",false);
   
-  Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > M = MueLu::CreateTpetraPreconditioner((Teuchos::RCP<LA_Operator>)J, mueluParams);
-
-  return M;
+  // Reuse (keep the data needed by MueLu::ReuseTpetraPreconditioner)
+  if (prec_reuse_type != "none" && prec_reuse_type != "full") {
+    mueluParams.set("reuse: type",prec_reuse_type);
+  }
+  
+  return mueluParams;
 }
 
 // ========================================================================================
@@ -1489,14 +2429,15 @@ void solver::finalizeMultiscale() {
     
     multiscale_manager->macro_wkset = assembler->wkset;
     ScalarT my_cost = multiscale_manager->initialize();
+    assembler->multiscale_manager = multiscale_manager;
     ScalarT gmin = 0.0;
     Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MIN,1,&my_cost,&gmin);
     //Comm->MinAll(&my_cost, &gmin, 1);
     ScalarT gmax = 0.0;
-    Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MAX,1,&my_cost,&gmin);
+    Teuchos::reduceAll(*Comm,Teuchos::REDUCE_MAX,1,&my_cost,&gmax);
     //Comm->MaxAll(&my_cost, &gmax, 1);
     
-    if(Comm->getRank() == 0 && verbosity>0) {
+    if(Comm->getRank() == 0 && verbosity>0 && gmin > 0.0) {
       cout << "***** Load Balancing Factor " << gmax/gmin <<  endl;
     }
     
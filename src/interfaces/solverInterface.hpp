@@ -25,6 +25,10 @@
 #include "assemblyManager.hpp"
 #include "parameterManager.hpp"
 #include "solutionStorage.hpp"
+#include "jacobianOperator.hpp"
+#include "generalRungeKutta.hpp"
+#include "blockPreconditioner.hpp"
+#include "singlePrecisionPreconditioner.hpp"
 
 // Belos
 #include <BelosConfigDefs.hpp>
@@ -96,6 +100,70 @@ public:
   void transientSolver(vector_RCP & initial, DFAD & obj, vector<ScalarT> & gradient,
                        ScalarT & start_time, ScalarT & end_time);
   
+  // ========================================================================================
+  // One time step with a diagonally implicit Runge-Kutta method (one nonlinear solve per stage)
+  // ========================================================================================
+  
+  int rungeKuttaStep(vector_RCP & u, vector_RCP & u_dot, vector_RCP & u_prev,
+                     const ScalarT & prev_time, const ScalarT & beta);
+  
+  // ========================================================================================
+  // Backtracking line search along the Newton step du (forward solves only)
+  // ========================================================================================
+  
+  void lineSearch(vector_RCP & u, vector_RCP & u_dot, vector_RCP & phi, vector_RCP & phi_dot,
+                  const ScalarT & alpha, const ScalarT & beta);
+  
+  // ========================================================================================
+  // One time step with an explicit Runge-Kutta method and a lumped mass matrix (no Jacobians)
+  // ========================================================================================
+  
+  int explicitStep(vector_RCP & u, vector_RCP & u_dot, vector_RCP & u_prev,
+                   const ScalarT & prev_time);
+  
+  void setupLumpedMass();
+  
+  // ========================================================================================
+  // Time step size control
+  // ========================================================================================
+  
+  ScalarT timeStepAlpha(const ScalarT & dt);
+  
+  ScalarT estimateTimeError(vector_RCP & u, vector_RCP & u_last, vector_RCP & u_dot_last,
+                            const ScalarT & dt);
+  
+  ScalarT timeStepFactor(const ScalarT & err, const ScalarT & err_prev);
+  
+  void updateMultiscale();
+  
+  // ========================================================================================
+  // One adjoint time step (implicit Euler) given the forward states at the step and the previous step
+  // ========================================================================================
+  
+  void adjointTimeStep(const size_t & timeiter, vector_RCP & u, vector_RCP & u_prev, vector_RCP & phi,
+                       vector<ScalarT> & gradient, const ScalarT & alpha, const ScalarT & beta);
+  
+  // ========================================================================================
+  // Checkpointing for the transient adjoint (binomial/revolve schedule)
+  // ========================================================================================
+  
+  void setForwardCheckpoints(const size_t & nsteps);
+  
+  size_t checkpointSplit(const size_t & s, const size_t & e, const int & numfree);
+  
+  bool haveCheckpoint(const size_t & step);
+  
+  int numCheckpoints();
+  
+  void recomputeForward(vector_RCP & u, const size_t & s, const size_t & e,
+                        const ScalarT & beta);
+  
+  void recomputeStep(vector_RCP & u, vector_RCP & u_dot, const size_t & i,
+                     const ScalarT & beta);
+  
+  void checkpointAdjoint(const size_t & s, const size_t & e, vector_RCP & phi, vector<ScalarT> & gradient,
+                         const ScalarT & beta);
+  
   // ========================================================================================
   // ========================================================================================
   
@@ -137,12 +205,31 @@ public:
   
   void linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln);
   
+  // ========================================================================================
+  // Linear solver with a separate operator (J is only used for the preconditioner)
+  // ========================================================================================
+  
+  void linearSolver(matrix_RCP & J, vector_RCP & r, vector_RCP & soln,
+                    const Teuchos::RCP<LA_Operator> & A);
+  
   // ========================================================================================
   // Preconditioner for Tpetra stack
   // ========================================================================================
   
   Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > buildPreconditioner(const matrix_RCP & J);
   
+  // ========================================================================================
+  // MueLu settings (shared by the double and single precision preconditioners)
+  // ========================================================================================
+  
+  Teuchos::ParameterList getMueLuParams();
+  
+  // ========================================================================================
+  // Field-split preconditioner (variable splits from the "block splits" setting)
+  // ========================================================================================
+  
+  void setupBlockPreconditioner();
+  
   // ========================================================================================
   // ========================================================================================
   
@@ -171,12 +258,21 @@ public:
   Teuchos::RCP<LA_Export> exporter;
   Teuchos::RCP<LA_Import> importer;
   
+  // Linear algebra objects for the nonlinear solver (built once on the static graphs)
+  matrix_RCP J, J_over;
+  vector_RCP res, res_over, du, du_over;
+  
   LO numUnknowns, numUnknownsOS;
   GO globalNumUnknowns;
   int verbosity, batchID, spaceDim, numsteps, gNLiter, milo_debug_level, MaxNLiter, time_order, liniter, kspace, maxNumEntPerRow;
 
   vector<GO>  owned, ownedAndShared, LA_owned, LA_ownedAndShared;
   
+  // Globalization and inexact Newton
+  int ls_max_backtracks;
+  ScalarT ls_decrease, lintol_current, ew_eta0, ew_eta_max, ew_gamma;
+  bool use_eisenstat_walker;
+  
   ScalarT NLtol, final_time, lintol, dropTol, fillParam, current_time, initial_time, deltat;
   
   string solver_type, NLsolver, initial_type, response_type, multigrid_type, smoother_type;
@@ -190,6 +286,53 @@ public:
   Teuchos::RCP<Amesos2::Solver<LA_CrsMatrix,LA_MultiVector> > Am2Solver;
   bool have_symbolic_factor;
   
+  // Preconditioner and factorization reuse
+  Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > M;
+  string prec_reuse_type;
+  int prec_reuse_max, prec_reuse_num, prec_rebuild_iters, factor_reuse_max, factor_reuse_num;
+  bool rebuild_prec;
+  LA_CrsMatrix * prec_matrix; // matrices used to build M and the factorization (only compared)
+  LA_CrsMatrix * factor_matrix;
+  bool reuse_adjoint; // problem (forward/adjoint and alpha) the reused M and factorization were built for
+  ScalarT reuse_alpha;
+  
+  // Block (field-split) preconditioner
+  string prec_type, block_prec_type, schur_type, block_splits;
+  Teuchos::RCP<BlockPreconditioner> blockM;
+  
+  // Mixed precision (single precision MueLu hierarchy)
+  string prec_precision;
+#ifdef MILO_HAVE_SINGLE_PRECISION
+  Teuchos::RCP<SinglePrecisionPreconditioner> M_sp;
+#endif
+  
+  // Matrix-free Newton-Krylov (J is only assembled every mf_prec_lag iterations for the preconditioner)
+  bool use_matrix_free;
+  int mf_prec_lag, mf_lag_num;
+  string mf_derivative; // "finite difference" (one residual per product) or "AD"
+  Teuchos::RCP<MatrixFreeJacobian> mf_J;
+  
+  // Runge-Kutta time integration (only used for methods other than backward Euler)
+  Teuchos::RCP<RungeKutta> timeInt;
+  bool use_rk_stages;
+  vector<vector_RCP> stage_u_dot; // time derivative at each stage of the current step
+  
+  // Explicit Runge-Kutta time integration
+  bool use_explicit;
+  vector_RCP lumped_mass_inv; // inverse of the lumped mass (owned map)
+  ScalarT explicit_cfl, explicit_wave_speed, mesh_hmin;
+  
+  // Adaptive time stepping
+  bool adaptive_timestep;
+  ScalarT initial_deltat, dt_tol_rel, dt_tol_abs, dt_min, dt_max, dt_growth, dt_safety;
+  int maxCuts;
+  
+  // Checkpointing for transient adjoints: only checkpoint_storage forward states (besides the initial state)
+  // are stored and the others are recomputed during the adjoint sweep (0 = store every state)
+  int checkpoint_storage;
+  vector<ScalarT> forward_times; // times of the accepted forward steps (starting with the initial time)
+  std::set<size_t> forward_checkpoints; // steps stored during the forward sweep
+  
   //bvbw Teuchos::RCP<SolutionStorage<LA_MultiVector> > soln, adj_soln, soln_dot;
   Teuchos::RCP<SolutionStorage<LA_MultiVector> > adj_soln, soln, soln_dot;
   
@@ -212,12 +355,17 @@ private:
   
   Teuchos::RCP<Teuchos::Time> assemblytimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - total assembly");
   Teuchos::RCP<Teuchos::Time> linearsolvertimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::linearSolver()");
+  Teuchos::RCP<Teuchos::Time> precsetuptimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::linearSolver() - preconditioner setup");
   Teuchos::RCP<Teuchos::Time> gathertimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - gather");
   Teuchos::RCP<Teuchos::Time> phystimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - physics evaluation");
   Teuchos::RCP<Teuchos::Time> boundarytimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - boundary evaluation");
   Teuchos::RCP<Teuchos::Time> inserttimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - insert");
   Teuchos::RCP<Teuchos::Time> dbctimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - strong Dirichlet BCs");
   Teuchos::RCP<Teuchos::Time> completetimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - fill complete");
+  Teuchos::RCP<Teuchos::Time> linesearchtimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::lineSearch()");
+  Teuchos::RCP<Teuchos::Time> explicitsteptimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::explicitStep()");
+  Teuchos::RCP<Teuchos::Time> rksteptimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::rungeKuttaStep()");
+  Teuchos::RCP<Teuchos::Time> recomputetimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::transientSolver() - checkpoint recomputation");
   Teuchos::RCP<Teuchos::Time> msprojtimer = Teuchos::TimeMonitor::getNewCounter("MILO::solver::computeJacRes() - multiscale projection");
   
 };
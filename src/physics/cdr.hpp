@@ -92,7 +92,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,cnum,k,0)*basis(e,i,k) + // transient term
             diff(e,k)*(sol_grad(e,cnum,k,0)*basis_grad(e,i,k,0)) + // diffusion terms
             (xvel(e,k)*sol_grad(e,cnum,k,0))*basis(e,i,k) + // convection terms
@@ -108,7 +108,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,cnum,k,0)*basis(e,i,k) + // transient term
             diff(e,k)*(sol_grad(e,cnum,k,0)*basis_grad(e,i,k,0) + sol_grad(e,cnum,k,1)*basis_grad(e,i,k,1)) + // diffusion terms
             (xvel(e,k)*sol_grad(e,cnum,k,0) + yvel(e,k)*sol_grad(e,cnum,k,1))*basis(e,i,k) + // convection terms
@@ -124,7 +124,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(cnum,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,cnum,k,0)*basis(e,i,k) + // transient term
             diff(e,k)*(sol_grad(e,cnum,k,0)*basis_grad(e,i,k,0) + sol_grad(e,cnum,k,1)*basis_grad(e,i,k,1) + sol_grad(e,cnum,k,2)*basis_grad(e,i,k,2)) + // diffusion terms
             (xvel(e,k)*sol_grad(e,cnum,k,0) + yvel(e,k)*sol_grad(e,cnum,k,1) + zvel(e,k)*sol_grad(e,cnum,k,2))*basis(e,i,k) + // convection terms
@@ -133,11 +133,11 @@ public:
       
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (size_t k=0; k<basis.extent(2); k++ ) {
-          this->setLocalSoln(e,k,false);
+          //this->setLocalSoln(e,k,false);
           for (int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            resindex = offsets(dx_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            int resindex = offsets(dx_num,i);
             res(e,resindex) += stress(e,k,0,0)*dvdx - source_dx(e,k)*v;
           }
         }
@@ -154,10 +154,10 @@ public:
         for (size_t k=0; k<basis.extent(2); k++ ) {
           //this->setLocalSoln(e,k,false);
           for (int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            dvdy = basis_grad(e,i,k,1);
-            resindex = offsets(dx_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            ScalarT dvdy = basis_grad(e,i,k,1);
+            int resindex = offsets(dx_num,i);
             
             res(e,resindex) += stress(e,k,0,0)*dvdx + stress(e,k,0,1)*dvdy - source_dx(e,k)*v;
           
@@ -176,10 +176,10 @@ public:
           //this->setLocalSoln(e,k,false);
           
           for (int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            dvdy = basis_grad(e,i,k,1);
-            resindex = offsets(dy_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            ScalarT dvdy = basis_grad(e,i,k,1);
+            int resindex = offsets(dy_num,i);
             
             res(e,resindex) += stress(e,k,1,0)*dvdx + stress(e,k,1,1)*dvdy - source_dy(e,k)*v;
             
@@ -196,13 +196,13 @@ public:
       
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for(size_t k=0; k<basis.extent(2); k++ ) {
-          this->setLocalSoln(e,k,false);
+          //this->setLocalSoln(e,k,false);
           for( int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            dvdy = basis_grad(e,i,k,1);
-            dvdz = basis_grad(e,i,k,2);
-            resindex = offsets(dx_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            ScalarT dvdy = basis_grad(e,i,k,1);
+            ScalarT dvdz = basis_grad(e,i,k,2);
+            int resindex = offsets(dx_num,i);
             res(e,resindex) += stress(e,k,0,0)*dvdx + stress(e,k,0,1)*dvdy + stress(e,k,0,2)*dvdz - source_dx(e,k)*v;
           }
         }
@@ -215,13 +215,13 @@ public:
       
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for(size_t k=0; k<basis.extent(2); k++ ) {
-          this->setLocalSoln(e,k,false);
+          //this->setLocalSoln(e,k,false);
           for( int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            dvdy = basis_grad(e,i,k,1);
-            dvdz = basis_grad(e,i,k,2);
-            resindex = offsets(dy_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            ScalarT dvdy = basis_grad(e,i,k,1);
+            ScalarT dvdz = basis_grad(e,i,k,2);
+            int resindex = offsets(dy_num,i);
             res(e,resindex) += stress(e,k,1,0)*dvdx + stress(e,k,1,1)*dvdy + stress(e,k,1,2)*dvdz - source_dy(e,k)*v;
           }
         }
@@ -234,13 +234,13 @@ public:
       
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for(size_t k=0; k<basis.extent(2); k++ ) {
-          this->setLocalSoln(e,k,false);
+          //this->setLocalSoln(e,k,false);
           for( int i=0; i<basis.extent(1); i++ ) {
-            v = basis(e,i,k);
-            dvdx = basis_grad(e,i,k,0);
-            dvdy = basis_grad(e,i,k,1);
-            dvdz = basis_grad(e,i,k,2);
-            resindex = offsets(dz_num,i);
+            ScalarT v = basis(e,i,k);
+            ScalarT dvdx = basis_grad(e,i,k,0);
+            ScalarT dvdy = basis_grad(e,i,k,1);
+            ScalarT dvdz = basis_grad(e,i,k,2);
+            int resindex = offsets(dz_num,i);
             res(e,resindex) += stress(e,k,2,0)*dvdx + stress(e,k,2,1)*dvdy + stress(e,k,2,2)*dvdz - source_dz(e,k)*v;
           }
         }
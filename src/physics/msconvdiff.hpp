@@ -98,7 +98,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(canum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(canum,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,canum,k,0)*basis(e,i,k) + // transient term
             xdiff(e,k)*(sol_grad(e,canum,k,0)*basis_grad(e,i,k,0)) + // diffusion terms
             (xvel(e,k)*sol_grad(e,canum,k,0))*basis(e,i,k) + // convection terms
@@ -128,7 +128,7 @@ public:
 	  AD dcbdx = sol_grad(e,cbnum,k,0);
 	  AD dcbdy = sol_grad(e,cbnum,k,1);
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(canum,i); 
+            int resindex = offsets(canum,i); 
 	    res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,canum,k,0)*basis(e,i,k) + // transient term
 	      (xdiff(e,k)*dcadx*basis_grad(e,i,k,0) + ydiff(e,k)*dcady*basis_grad(e,i,k,1)) + // diffusion terms
 	      (xvel(e,k)*dcadx + yvel(e,k)*dcady)*basis(e,i,k) + // convection terms
@@ -154,7 +154,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(canum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(canum,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,canum,k,0)*basis(e,i,k) + // transient term
             xdiff(e,k)*(sol_grad(e,canum,k,0)*basis_grad(e,i,k,0) + sol_grad(e,canum,k,1)*basis_grad(e,i,k,1) + sol_grad(e,canum,k,2)*basis_grad(e,i,k,2)) + // diffusion terms
             (xvel(e,k)*sol_grad(e,canum,k,0) + yvel(e,k)*sol_grad(e,canum,k,1) + zvel(e,k)*sol_grad(e,canum,k,2))*basis(e,i,k) + // convection terms
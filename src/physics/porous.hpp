@@ -81,7 +81,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
             AD dens = densref(e,k)*(1.0+comp(e,k)*(sol(e,pnum,k,0) - pref(e,k)));
             
             res(e,resindex) += porosity(e,k)*densref(e,k)*comp(e,k)*sol_dot(e,pnum,k,0)*basis(e,i,k) + // transient term
@@ -96,7 +96,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
             AD dens = densref(e,k)*(1.0+comp(e,k)*(sol(e,pnum,k,0) - pref(e,k)));
             
             res(e,resindex) += porosity(e,k)*densref(e,k)*comp(e,k)*sol_dot(e,pnum,k,0)*basis(e,i,k) + // transient term
@@ -110,7 +110,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(pnum,i); // TMW: e_num is not on the assembly device
             
             AD dens = densref(e,k)*(1.0+comp(e,k)*(sol(e,pnum,k,0) - pref(e,k)));
             
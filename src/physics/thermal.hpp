@@ -50,13 +50,13 @@ public:
     // Functions
     Teuchos::ParameterList fs = settings->sublist("Functions");
     
-    functionManager->addFunction("thermal source",fs.get<string>("thermal source","0.0"),numElem,numip,"ip",blocknum);
-    functionManager->addFunction("thermal diffusion",fs.get<string>("thermal diffusion","1.0"),numElem,numip,"ip",blocknum);
-    functionManager->addFunction("specific heat",fs.get<string>("specific heat","1.0"),numElem,numip,"ip",blocknum);
-    functionManager->addFunction("density",fs.get<string>("density","1.0"),numElem,numip,"ip",blocknum);
+    source_fn = functionManager->addFunction("thermal source",fs.get<string>("thermal source","0.0"),numElem,numip,"ip",blocknum);
+    diff_fn = functionManager->addFunction("thermal diffusion",fs.get<string>("thermal diffusion","1.0"),numElem,numip,"ip",blocknum);
+    cp_fn = functionManager->addFunction("specific heat",fs.get<string>("specific heat","1.0"),numElem,numip,"ip",blocknum);
+    rho_fn = functionManager->addFunction("density",fs.get<string>("density","1.0"),numElem,numip,"ip",blocknum);
     //functionManager->addFunction("thermal Neumann source",fs.get<string>("thermal Neumann source","0.0"),numElem,numip_side,"side ip",blocknum);
-    functionManager->addFunction("thermal diffusion",fs.get<string>("thermal diffusion","1.0"),numElem,numip_side,"side ip",blocknum);
-    functionManager->addFunction("robin alpha",fs.get<string>("robin alpha","0.0"),numElem,numip_side,"side ip",blocknum);
+    diff_side_fn = functionManager->addFunction("thermal diffusion",fs.get<string>("thermal diffusion","1.0"),numElem,numip_side,"side ip",blocknum);
+    robin_alpha_fn = functionManager->addFunction("robin alpha",fs.get<string>("robin alpha","0.0"),numElem,numip_side,"side ip",blocknum);
     
   }
   
@@ -74,19 +74,36 @@ public:
     //offsets = wkset->offsets;
     {
       Teuchos::TimeMonitor funceval(*volumeResidualFunc);
-      source = functionManager->evaluate("thermal source","ip",blocknum);
-      diff = functionManager->evaluate("thermal diffusion","ip",blocknum);
-      cp = functionManager->evaluate("specific heat","ip",blocknum);
-      rho = functionManager->evaluate("density","ip",blocknum);
+      source = functionManager->evaluate(source_fn,blocknum);
+      diff = functionManager->evaluate(diff_fn,blocknum);
+      cp = functionManager->evaluate(cp_fn,blocknum);
+      rho = functionManager->evaluate(rho_fn,blocknum);
     }
     
     Teuchos::TimeMonitor resideval(*volumeResidualFill);
     
-    if (spaceDim ==1) {
+    if (wkset->use_sum_factorization && wkset->tensor_basis[e_basis_num] && !have_nsvel) {
+      // High-order quads/hexes: only form the coefficients at the ip and let the workset
+      // integrate against the basis using sum factorization
+      if (sf_source.extent(0) != res.extent(0) || sf_source.extent(1) != sol.extent(2)) {
+        sf_source = Kokkos::View<AD**,AssemblyDevice>("thermal sf source",res.extent(0),sol.extent(2));
+        sf_flux = Kokkos::View<AD***,AssemblyDevice>("thermal sf flux",res.extent(0),sol.extent(2),spaceDim);
+      }
+      parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
+        for (int k=0; k<sol.extent(2); k++ ) {
+          sf_source(e,k) = rho(e,k)*cp(e,k)*sol_dot(e,e_num,k,0) - source(e,k);
+          for (int s=0; s<spaceDim; s++ ) {
+            sf_flux(e,k,s) = diff(e,k)*sol_grad(e,e_num,k,s);
+          }
+        }
+      });
+      wkset->integrateTensor(e_basis_num, e_num, sf_source, sf_flux);
+    }
+    else if (spaceDim ==1) {
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(e_num,i); // TMW: e_num is not on the assembly device
+            int resindex = offsets(e_num,i); // TMW: e_num is not on the assembly device
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,e_num,k,0)*basis(e,i,k) +
                                diff(e,k)*(sol_grad(e,e_num,k,0)*basis_grad(e,i,k,0)) -
                                source(e,k)*basis(e,i,k);
@@ -102,7 +119,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(e_num,i);
+            int resindex = offsets(e_num,i);
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,e_num,k,0)*basis(e,i,k) +
                                diff(e,k)*(sol_grad(e,e_num,k,0)*basis_grad(e,i,k,0) +
                                           sol_grad(e,e_num,k,1)*basis_grad(e,i,k,1)) -
@@ -119,7 +136,7 @@ public:
       parallel_for(RangePolicy<AssemblyDevice>(0,res.extent(0)), KOKKOS_LAMBDA (const int e ) {
         for (int k=0; k<sol.extent(2); k++ ) {
           for (int i=0; i<basis.extent(1); i++ ) {
-            resindex = offsets(e_num,i);
+            int resindex = offsets(e_num,i);
             res(e,resindex) += rho(e,k)*cp(e,k)*sol_dot(e,e_num,k,0)*basis(e,i,k) +
                                diff(e,k)*(sol_grad(e,e_num,k,0)*basis_grad(e,i,k,0) +
                                           sol_grad(e,e_num,k,1)*basis_grad(e,i,k,1) +
@@ -163,8 +180,8 @@ public:
       else if (sidetype == 2) {
         nsource = functionManager->evaluate("Neumann e " + wkset->sidename,"side ip",blocknum);
       }
-      diff_side = functionManager->evaluate("thermal diffusion","side ip",blocknum);
-      robin_alpha = functionManager->evaluate("robin alpha","side ip",blocknum);
+      diff_side = functionManager->evaluate(diff_side_fn,blocknum);
+      robin_alpha = functionManager->evaluate(robin_alpha_fn,blocknum);
       
     }
     
@@ -257,7 +274,7 @@ public:
 
     {
       Teuchos::TimeMonitor localtime(*fluxFunc);
-      diff_side = functionManager->evaluate("thermal diffusion","side ip",blocknum);
+      diff_side = functionManager->evaluate(diff_side_fn,blocknum);
     }
     
     // Since normals get recomputed often, this needs to be reset
@@ -318,6 +335,7 @@ private:
   int spaceDim, numElem, numParams, numResponses;
   vector<string> varlist;
   int e_num, e_basis, numBasis, ux_num, uy_num, uz_num;
+  int source_fn, diff_fn, cp_fn, rho_fn, diff_side_fn, robin_alpha_fn; // function indices
   ScalarT alpha;
   bool isTD;
   //int test, simNum;
@@ -330,6 +348,8 @@ private:
   int resindex;
   
   FDATA diff, rho, cp, source, nsource, diff_side, robin_alpha;
+  Kokkos::View<AD**,AssemblyDevice> sf_source;
+  Kokkos::View<AD***,AssemblyDevice> sf_flux;
   Kokkos::View<int****,AssemblyDevice> sideinfo;
   
   string analysis_type; //to know when parameter is a sample that needs to be transformed
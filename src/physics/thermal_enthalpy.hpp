@@ -129,7 +129,7 @@ public:
         }
         for (int i=0; i<basis.extent(1); i++ ) {
           
-          resindex = offsets(e_num,i);
+          int resindex = offsets(e_num,i);
           v = basis(e,i,k);
           dvdx = basis_grad(e,i,k,0);
           if (spaceDim > 1) {
@@ -162,7 +162,7 @@ public:
         AD H = sol(e,H_num,k,0);
         
         for (int i=0; i<basis.extent(1); i++ ) {
-          resindex = wkset->offsets(H_num,i);
+          int resindex = wkset->offsets(H_num,i);
           v = basis(e,i,k);
           // make cp_integral and gfunc udfuncs
           //cp_integral = 320.3*e + 0.379/2.0*e*e;
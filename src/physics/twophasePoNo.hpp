@@ -142,7 +142,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // No equation
-            resindex = offsets(Nonum,i);
+            int resindex = offsets(Nonum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0)) // diffusion terms
@@ -190,7 +190,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // No equation
-            resindex = offsets(Ponum,i);
+            int resindex = offsets(Ponum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0) +
@@ -242,7 +242,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // Po equation
-            resindex = offsets(Nonum,i);
+            int resindex = offsets(Nonum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0) +
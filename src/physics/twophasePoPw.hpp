@@ -142,7 +142,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // No equation
-            resindex = offsets(Pwnum,i);
+            int resindex = offsets(Pwnum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0)) // diffusion terms
@@ -187,7 +187,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // No equation
-            resindex = offsets(Ponum,i);
+            int resindex = offsets(Ponum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0) +
@@ -234,7 +234,7 @@ public:
           for (int i=0; i<basis.extent(1); i++ ) { // loop over basis functions
             
             // Po equation
-            resindex = offsets(Pwnum,i);
+            int resindex = offsets(Pwnum,i);
             
             res(e,resindex) += porosity(e,k)*dNo_dt*basis(e,i,k) + // transient term
             perm(e,k)*relperm_o(e,k)/viscosity_o(e,k)*rhoo*(dPo_dx*basis_grad(e,i,k,0) +
@@ -23,7 +23,18 @@ typedef double ScalarT;
 typedef int LO;
 typedef long long int GO;
 
-#define maxDerivs 64 // adjust this to improve performance
+// Number of derivatives carried by the AD type (selected at configure time with MILO_MAX_DERIVS)
+// All operations on AD values cost maxDerivs flops, so this should be close to the largest
+// number of DOF per element (or active parameters) in the problem
+// A single size is used for all blocks: the workset, cells and physics modules use the AD
+// typedef directly, so per-block sizes would mean templating all of them on the AD type.
+// A DFad fallback is not provided either, since the AD views are allocated without the
+// Sacado derivative dimension and DFad allocates on the heap in the assembly loops.
+#ifdef MILO_MAX_DERIVS
+#define maxDerivs MILO_MAX_DERIVS
+#else
+#define maxDerivs 64
+#endif
 #define PI 3.141592653589793238463
 #define MILO_DEBUG false
 typedef Teuchos::MpiComm<int> LA_MpiComm;
@@ -33,12 +44,19 @@ typedef Sacado::Fad::DFad<ScalarT> DFAD; // used only when absolutely necessary
 typedef Sacado::Fad::SFad<ScalarT,maxDerivs> AD;
 
 // Kokkos Device typedefs
+// The assembly device and the Tpetra node are selected at configure time (MILO_ENABLE_OPENMP)
+// The subgrid models are called from inside the macro-scale element loop, so they stay serial
+#ifdef MILO_ENABLE_OPENMP
+typedef Kokkos::OpenMP AssemblyDevice;
+typedef Kokkos::OpenMP HostDevice;
+typedef Kokkos::Compat::KokkosOpenMPWrapperNode HostNode;
+#else
 typedef Kokkos::Serial AssemblyDevice;
 typedef Kokkos::Serial HostDevice;
-typedef Kokkos::Serial SubgridDevice;
 typedef Kokkos::Compat::KokkosSerialWrapperNode HostNode;
+#endif
+typedef Kokkos::Serial SubgridDevice;
 typedef Kokkos::Compat::KokkosSerialWrapperNode SubgridNode;
-//typedef Kokkos::Compat::KokkosOpenMPWrapperNode HostNode;
 //typedef Kokkos::Compat::KokkosThreadsWrapperNode HostNode;
 //typedef Kokkos::Compat::KokkosCudaWrapperNode HostNode;
 
@@ -73,6 +91,17 @@ typedef Tpetra::Map<LO, GO, HostNode>               LA_Map;
 typedef Tpetra::Operator<ScalarT,LO,GO,HostNode>    LA_Operator;
 typedef Tpetra::MultiVector<ScalarT,LO,GO,HostNode> LA_MultiVector;
 typedef Tpetra::MultiVector<ScalarT,LO,GO,HostNode> LA_MultiVector;
+
+// Single precision objects for the mixed precision preconditioner
+// (configure with MILO_ENABLE_MIXED_PRECISION and Tpetra/MueLu instantiated on float)
+#include "TpetraCore_config.h"
+#if defined(MILO_ENABLE_MIXED_PRECISION) && defined(HAVE_TPETRA_INST_FLOAT)
+#define MILO_HAVE_SINGLE_PRECISION
+typedef float PrecScalarT;
+typedef Tpetra::CrsMatrix<PrecScalarT,LO,GO,HostNode>   LA_CrsMatrix_sp;
+typedef Tpetra::Operator<PrecScalarT,LO,GO,HostNode>    LA_Operator_sp;
+typedef Tpetra::MultiVector<PrecScalarT,LO,GO,HostNode> LA_MultiVector_sp;
+#endif
 //typedef Belos::LinearProblem<ScalarT, LA_MultiVector, LA_Operator> LA_LinearProblem;
 
 
@@ -80,6 +80,10 @@ int main(int argc, char * argv[]) {
   functionManager->addFunction("wellr",wellr,numElem,numip,"ip",0);
   functionManager->addFunction("source",source,numElem,numip,"ip",0);
   
+  // A chain of references (wellcc is compiled before the function it references)
+  functionManager->addFunction("wellcc","wellc",numElem,numip,"ip",0);
+  functionManager->addFunction("wellc","well",numElem,numip,"ip",0);
+  
   functionManager->validateFunctions();
   functionManager->decomposeFunctions();
   
@@ -125,6 +129,31 @@ int main(int argc, char * argv[]) {
   }
   
   
+  // Compare the compiled evaluation with the recursive evaluation
+  vector<string> checknames = {"g","source","wellcc"};
+  for (size_t f=0; f<checknames.size(); f++) {
+    int findex = functionManager->getFunctionIndex(checknames[f],"ip",0);
+    FDATA cdata = functionManager->evaluate(findex,0);
+    vector<ScalarT> cvals;
+    for (size_t i=0; i<numElem; i++) {
+      for (size_t j=0; j<numip; j++) {
+        cvals.push_back(cdata(i,j).val());
+      }
+    }
+    functionManager->evaluate(0,findex,0);
+    term & rterm = functionManager->functions[0][findex].terms[0];
+    ScalarT maxdiff = 0.0;
+    for (size_t i=0; i<numElem; i++) {
+      for (size_t j=0; j<numip; j++) {
+        ScalarT rval = rterm.isAD ? rterm.data(i,j).val() : rterm.ddata(i,j);
+        maxdiff = std::max(maxdiff, std::abs(cvals[i*numip+j] - rval)/std::max(1.0,std::abs(rval)));
+      }
+    }
+    cout << checknames[f] << " is compiled: " << functionManager->functions[0][findex].isCompiled << endl;
+    cout << "max relative difference between compiled and recursive evaluation of " << checknames[f] << " = " << maxdiff << endl;
+    TEUCHOS_TEST_FOR_EXCEPTION(maxdiff > 1.0e-12,std::runtime_error,"Error: the compiled and recursive evaluations of " + checknames[f] + " do not match");
+  }
+  
   Teuchos::TimeMonitor::summarize();
   
   Kokkos::finalize();
@@ -37,6 +37,8 @@ Comm(Comm_), mesh(mesh_), disc(disc_), phys(phys_), DOF(DOF_), cells(cells_), bo
   verbosity = settings->get<int>("verbosity",0);
   usestrongDBCs = settings->sublist("Solver").get<bool>("use strong DBCs",true);
   useNewBCs = settings->sublist("Solver").get<bool>("use new BCs",true);
+  use_local_insert = settings->sublist("Solver").get<bool>("use local insert",true);
+  use_sum_factorization = settings->sublist("Solver").get<bool>("use sum factorization",false);
   use_meas_as_dbcs = settings->sublist("Mesh").get<bool>("Use Measurements as DBCs", false);
   
   // needed information from the mesh
@@ -77,6 +79,20 @@ void AssemblyManager::createWorkset() {
     
     wkset[b]->isInitialized = true;
     wkset[b]->block = b;
+    
+    if (use_sum_factorization) {
+      wkset[b]->setupTensorBasis();
+      if (verbosity > 0 && Comm->getRank() == 0) {
+        int numtensor = 0;
+        for (size_t i=0; i<wkset[b]->tensor_basis.size(); i++) {
+          if (wkset[b]->tensor_basis[i]) {
+            numtensor++;
+          }
+        }
+        cout << "**** Sum factorization is used for " << numtensor << " of " << wkset[b]->tensor_basis.size()
+             << " bases on block " << blocknames[b] << endl;
+      }
+    }
   }
   
   //phys->setWorkset(wkset);
@@ -146,7 +162,6 @@ void AssemblyManager::updateJacDBC(matrix_RCP & J, const vector<GO> & dofs, cons
   
   // given a "block" and the unknown field update jacobian to enforce Dirichlet BCs
   
-  //size_t numcols = J->getGlobalNumCols();
   for( int i=0; i<dofs.size(); i++ ) { // for each node
     if (compute_disc_sens) {
       GO numcols = globalParamUnknowns;
@@ -157,15 +172,96 @@ void AssemblyManager::updateJacDBC(matrix_RCP & J, const vector<GO> & dofs, cons
       }
     }
     else {
-      GO numcols = J->getGlobalNumCols();
-      for( GO col=0; col<numcols; col++ ) {
-        ScalarT m_val = 0.0; // set ALL of the entries to 0 in the Jacobian
-        J->replaceGlobalValues(dofs[i], 1, &m_val, &col);
+      // only the stored entries in the row need to be zeroed
+      size_t numEntries = J->getNumEntriesInGlobalRow(dofs[i]);
+      if (numEntries != Teuchos::OrdinalTraits<size_t>::invalid()) {
+        Teuchos::Array<GO> cols(numEntries);
+        Teuchos::Array<ScalarT> vals(numEntries);
+        J->getGlobalRowCopy(dofs[i], cols(), vals(), numEntries);
+        for (size_t k=0; k<numEntries; k++) {
+          vals[k] = (cols[k] == dofs[i]) ? 1.0 : 0.0; // set diagonal entry to 1
+        }
+        J->replaceGlobalValues(dofs[i], cols(), vals());
+      }
+    }
+  }
+}
+
+// ========================================================================================
+// ========================================================================================
+
+void AssemblyManager::setDirichletRows(const Teuchos::RCP<const LA_Map> & overlapped_map) {
+  
+  // Collects the rows from the Dirichlet sides and the point DBCs into a single sorted list
+  // of local rows for each block.  This assumes the DOF layout is fixed after setup.
+  
+  dbc_rows.clear();
+  for (size_t b=0; b<cells.size(); b++) {
+    string blockID = blocknames[b];
+    vector<LO> rows;
+    for (int n=0; n<numVars[b]; n++) {
+      int fnum = DOF->getFieldNum(varlist[b][n]);
+      vector<size_t> boundDirichletElemIDs = phys->boundDirichletElemIDs[b][n];
+      vector<size_t> localDirichletSideIDs = phys->localDirichletSideIDs[b][n];
+      for (size_t e=0; e<boundDirichletElemIDs.size(); e++) {
+        vector<GO> elemGIDs;
+        DOF->getElementGIDs(boundDirichletElemIDs[e], elemGIDs, blockID);
+        const pair<vector<int>,vector<int> > SideIndex = DOF->getGIDFieldOffsets_closure(blockID, fnum,
+                                                                                         (phys->spaceDim)-1,
+                                                                                         localDirichletSideIDs[e]);
+        const vector<int> elmtOffset = SideIndex.first; // local nodes on that side
+        for( size_t i=0; i<elmtOffset.size(); i++ ) {
+          rows.push_back(overlapped_map->getLocalElement(elemGIDs[elmtOffset[i]]));
+        }
       }
-      ScalarT val = 1.0; // set diagonal entry to 1
-      J->replaceGlobalValues(dofs[i], 1, &val, &dofs[i]);
     }
+    for (size_t i=0; i<phys->dbc_dofs[b].size(); i++) {
+      rows.push_back(overlapped_map->getLocalElement(phys->dbc_dofs[b][i]));
+    }
+    
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    TEUCHOS_TEST_FOR_EXCEPTION(rows.size() > 0 && rows[0] < 0,std::runtime_error,"Error: a Dirichlet DOF is not on the overlapped map");
+    
+    Kokkos::View<LO*,HostDevice> block_rows("Dirichlet rows",rows.size());
+    for (size_t i=0; i<rows.size(); i++) {
+      block_rows(i) = rows[i];
+    }
+    dbc_rows.push_back(block_rows);
   }
+  have_dbc_rows = true;
+  
+}
+
+// ========================================================================================
+// ========================================================================================
+
+void AssemblyManager::updateJacDBC(matrix_RCP & J, const Kokkos::View<LO*,HostDevice> & rows) {
+  
+  // zero the stored entries of each constrained row and set the diagonal to 1
+  // the rows and columns of the overlapped matrix share the same local indices
+  
+  auto J_kcrs = J->getLocalMatrix();
+  parallel_for(RangePolicy<HostDevice>(0,rows.extent(0)), KOKKOS_LAMBDA (const int i ) {
+    LO lrow = rows(i);
+    auto J_row = J_kcrs.row(lrow);
+    for (LO k=0; k<J_row.length; k++) {
+      J_row.value(k) = (J_row.colidx(k) == lrow) ? 1.0 : 0.0;
+    }
+  });
+}
+
+// ========================================================================================
+// ========================================================================================
+
+void AssemblyManager::updateResDBC(vector_RCP & resid, const Kokkos::View<LO*,HostDevice> & rows) {
+  
+  auto res_kv = resid->getLocalView<HostDevice>();
+  parallel_for(RangePolicy<HostDevice>(0,rows.extent(0)), KOKKOS_LAMBDA (const int i ) {
+    for (size_t j=0; j<res_kv.extent(1); j++) {
+      res_kv(rows(i),j) = 0.0;
+    }
+  });
 }
 
 // ========================================================================================
@@ -299,6 +395,36 @@ void AssemblyManager::setInitial(vector_RCP & initial, const bool & useadjoint)
 // ========================================================================================
 // ========================================================================================
 
+void AssemblyManager::getLumpedMass(vector_RCP & mass, ScalarT & hmin) {
+  
+  hmin = 1.0e300;
+  for (size_t b=0; b<cells.size(); b++) {
+    for (size_t e=0; e<cells[b].size(); e++) {
+      
+      int numElem = cells[b][e]->numElem;
+      Kokkos::View<GO**,HostDevice> GIDs = cells[b][e]->GIDs;
+      
+      // getMass updates the workset geometry, so h is for this cell afterwards
+      Kokkos::View<ScalarT***,AssemblyDevice> localmass = cells[b][e]->getMass();
+      
+      for (int c=0; c<numElem; c++) {
+        hmin = std::min(hmin, wkset[b]->h(c));
+        for( size_t row=0; row<GIDs.extent(1); row++ ) {
+          GO rowIndex = GIDs(c,row);
+          ScalarT val = 0.0;
+          for( size_t col=0; col<GIDs.extent(1); col++ ) {
+            val += localmass(c,row,col);
+          }
+          mass->sumIntoGlobalValue(rowIndex,0, val);
+        }
+      }
+    }
+  }
+}
+
+// ========================================================================================
+// ========================================================================================
+
 void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
                                      vector_RCP & phi, vector_RCP & phi_dot,
                                      const ScalarT & alpha, const ScalarT & beta,
@@ -409,6 +535,16 @@ void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
       }
     }
     
+    /////////////////////////////////////////////////////////////////////////////
+    // Subgrid problems solved on other ranks (needs all ranks, so before the cell loop)
+    /////////////////////////////////////////////////////////////////////////////
+    
+    if (!multiscale_manager.is_null() && cells[b][0]->cellData->subgrid_distributed) {
+      multiscale_manager->computeSubgridSolutions(b, current_time, isTransient, useadjoint,
+                                                  compute_jacobian, compute_sens, num_active_params,
+                                                  compute_disc_sens, false, store_adjPrev);
+    }
+    
     /////////////////////////////////////////////////////////////////////////////
     // Volume contribution
     /////////////////////////////////////////////////////////////////////////////
@@ -463,7 +599,7 @@ void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
       ///////////////////////////////////////////////////////////////////////////
       
       this->insert(J, res, local_res, local_J, local_Jdot,
-                   cells[b][e]->GIDs, cells[b][e]->paramGIDs,
+                   cells[b][e]->GIDs, cells[b][e]->LIDs, cells[b][e]->paramGIDs,
                    compute_jacobian, compute_disc_sens, alpha);
       
       
@@ -562,7 +698,7 @@ void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
           ///////////////////////////////////////////////////////////////////////////
           
           this->insert(J, res, local_res, local_J, local_Jdot,
-                       boundaryCells[b][e]->GIDs, boundaryCells[b][e]->paramGIDs,
+                       boundaryCells[b][e]->GIDs, boundaryCells[b][e]->LIDs, boundaryCells[b][e]->paramGIDs,
                        compute_jacobian, compute_disc_sens, alpha);
           
         }
@@ -573,7 +709,16 @@ void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
   
   // ************************** STRONGLY ENFORCE DIRICHLET BCs *******************************************
   
-  if (usestrongDBCs) {
+  if (usestrongDBCs && have_dbc_rows && !compute_disc_sens && (!compute_jacobian || (use_local_insert && J->isStaticGraph()))) {
+    Teuchos::TimeMonitor localtimer(*dbctimer);
+    for (size_t b=0; b<cells.size(); b++) {
+      if (compute_jacobian) {
+        this->updateJacDBC(J,dbc_rows[b]);
+      }
+      this->updateResDBC(res,dbc_rows[b]);
+    }
+  }
+  else if (usestrongDBCs) {
     Teuchos::TimeMonitor localtimer(*dbctimer);
     vector<vector<GO> > fixedDOFs = phys->dbc_dofs;
     for (size_t b=0; b<cells.size(); b++) {
@@ -609,6 +754,72 @@ void AssemblyManager::assembleJacRes(vector_RCP & u, vector_RCP & u_dot,
 }
 
 
+// ========================================================================================
+// Matrix-free action of the Jacobian on an overlapped vector
+// Uses the solution gathered into the cells by the last call to assembleJacRes, so this
+// must be called at the same state (e.g., within the linear solve of a Newton iteration)
+// ========================================================================================
+
+void AssemblyManager::applyJacobian(const vector_RCP & v, const ScalarT & alpha, vector_RCP & Jv) {
+  
+  Teuchos::TimeMonitor localtimer(*jacvectimer);
+  
+  matrix_RCP J_unused;
+  Kokkos::View<ScalarT***,AssemblyDevice> J_empty;
+  
+  for (size_t b=0; b<cells.size(); b++) {
+    TEUCHOS_TEST_FOR_EXCEPTION(wkset[b]->numAux > 0,std::runtime_error,"Error: the matrix-free Jacobian does not support auxiliary variables");
+    
+    for (size_t e=0; e < cells[b].size(); e++) {
+      wkset[b]->localEID = e;
+      cells[b][e]->updateData();
+      
+      Kokkos::View<ScalarT***,AssemblyDevice> local_Jv("local Jv",cells[b][e]->numElem,cells[b][e]->GIDs.extent(1),1);
+      cells[b][e]->computeJacVec(v, alpha, local_Jv);
+      
+      this->insert(J_unused, Jv, local_Jv, J_empty, J_empty,
+                   cells[b][e]->GIDs, cells[b][e]->LIDs, cells[b][e]->paramGIDs,
+                   false, false, alpha);
+    }
+    
+    if (useNewBCs && boundaryCells.size() > b) {
+      for (size_t e=0; e < boundaryCells[b].size(); e++) {
+        if (boundaryCells[b][e]->numElem > 0) {
+          wkset[b]->localEID = e;
+          
+          Kokkos::View<ScalarT***,AssemblyDevice> local_Jv("local Jv",boundaryCells[b][e]->numElem,boundaryCells[b][e]->GIDs.extent(1),1);
+          boundaryCells[b][e]->computeJacVec(v, alpha, local_Jv);
+          
+          this->insert(J_unused, Jv, local_Jv, J_empty, J_empty,
+                       boundaryCells[b][e]->GIDs, boundaryCells[b][e]->LIDs, boundaryCells[b][e]->paramGIDs,
+                       false, false, alpha);
+        }
+      }
+    }
+  }
+  
+  this->applyJacobianDBC(v, Jv);
+}
+
+// ========================================================================================
+// The rows of the strong DBCs are identity rows (consistent with updateJacDBC)
+// ========================================================================================
+
+void AssemblyManager::applyJacobianDBC(const vector_RCP & v, vector_RCP & Jv) {
+  if (usestrongDBCs) {
+    Teuchos::TimeMonitor localtimer(*dbctimer);
+    TEUCHOS_TEST_FOR_EXCEPTION(!have_dbc_rows,std::runtime_error,"Error: the matrix-free Jacobian requires the Dirichlet rows to be set (setDirichletRows)");
+    auto v_kv = v->getLocalView<HostDevice>();
+    auto Jv_kv = Jv->getLocalView<HostDevice>();
+    for (size_t b=0; b<dbc_rows.size(); b++) {
+      Kokkos::View<LO*,HostDevice> rows = dbc_rows[b];
+      parallel_for(RangePolicy<HostDevice>(0,rows.extent(0)), KOKKOS_LAMBDA (const int i ) {
+        Jv_kv(rows(i),0) = v_kv(rows(i),0);
+      });
+    }
+  }
+}
+
 // ========================================================================================
 //
 // ========================================================================================
@@ -761,6 +972,7 @@ void AssemblyManager::insert(matrix_RCP & J, vector_RCP & res,
                              Kokkos::View<ScalarT***,AssemblyDevice> & local_J,
                              Kokkos::View<ScalarT***,AssemblyDevice> & local_Jdot,
                              Kokkos::View<GO**,HostDevice> & GIDs,
+                             Kokkos::View<LO**,HostDevice> & LIDs,
                              Kokkos::View<GO**,HostDevice> & paramGIDs,
                              const bool & compute_jacobian,
                              const bool & compute_disc_sens,
@@ -768,9 +980,51 @@ void AssemblyManager::insert(matrix_RCP & J, vector_RCP & res,
 
   Teuchos::TimeMonitor localtimer(*inserttimer);
   
+  bool have_local_indices = (LIDs.extent(0) == GIDs.extent(0) && LIDs.extent(1) == GIDs.extent(1));
+  
+  if (use_local_insert && have_local_indices && !compute_disc_sens && (!compute_jacobian || J->isStaticGraph())) {
+    
+    // Fast path: scatter the whole workset directly into the local matrix and vector views.
+    // The rows and columns of the overlapped matrix share the same local indices, so the
+    // precomputed LIDs can be used for both, and no global-to-local lookups are needed.
+    // The updates are atomic since neighboring elements share rows.
+    
+    auto res_kv = res->getLocalView<HostDevice>();
+    
+    parallel_for(RangePolicy<HostDevice>(0,LIDs.extent(0)), KOKKOS_LAMBDA (const int i ) {
+      for (size_t row=0; row<LIDs.extent(1); row++) {
+        LO rowIndex = LIDs(i,row);
+        for (size_t g=0; g<local_res.extent(2); g++) {
+          Kokkos::atomic_add(&(res_kv(rowIndex,g)), local_res(i,row,g));
+        }
+      }
+    });
+    
+    if (compute_jacobian) {
+      auto J_kcrs = J->getLocalMatrix();
+      LO numcols = LIDs.extent(1);
+      
+      // local_J is overwritten with J + alpha*Jdot so each row can be passed as a contiguous block
+      parallel_for(RangePolicy<HostDevice>(0,LIDs.extent(0)), KOKKOS_LAMBDA (const int i ) {
+        for (LO row=0; row<numcols; row++) {
+          for (LO col=0; col<numcols; col++) {
+            local_J(i,row,col) += alpha*local_Jdot(i,row,col);
+          }
+          J_kcrs.sumIntoValues(LIDs(i,row), &(LIDs(i,0)), numcols, &(local_J(i,row,0)), false, true);
+        }
+      });
+    }
+    return;
+  }
+  
+  // General path using global indices (also handles the discretized parameter sensitivities)
+  // This loop is intentionally a serial host loop (not a parallel_for on the AssemblyDevice).
+  // Neighboring elements share rows, and the global sumInto/insert calls on a matrix
+  // without a static graph are not thread-safe.
+  Teuchos::Array<ScalarT> vals(GIDs.extent(1));
+  Teuchos::Array<GO> cols(GIDs.extent(1));
+  
   for (int i=0; i<GIDs.extent(0); i++) {
-    Teuchos::Array<ScalarT> vals(GIDs.extent(1));
-    Teuchos::Array<GO> cols(GIDs.extent(1));
     
     for( size_t row=0; row<GIDs.extent(1); row++ ) {
       GO rowIndex = GIDs(i,row);
@@ -22,6 +22,7 @@
 #include "physicsInterface.hpp"
 #include "discretizationInterface.hpp"
 #include "parameterManager.hpp"
+#include "multiscaleInterface.hpp"
 
 
 void static assemblyHelp(const string & details) {
@@ -69,6 +70,22 @@ public:
   
   void updateResDBC(vector_RCP & resid, const vector<GO> & dofs);
   
+  // ========================================================================================
+  // Precompute the local (overlapped map) rows constrained by the strong Dirichlet BCs
+  // ========================================================================================
+  
+  void setDirichletRows(const Teuchos::RCP<const LA_Map> & overlapped_map);
+  
+  // ========================================================================================
+  // ========================================================================================
+  
+  void updateJacDBC(matrix_RCP & J, const Kokkos::View<LO*,HostDevice> & rows);
+  
+  // ========================================================================================
+  // ========================================================================================
+  
+  void updateResDBC(vector_RCP & resid, const Kokkos::View<LO*,HostDevice> & rows);
+  
   
   // ========================================================================================
   // ========================================================================================
@@ -87,6 +104,12 @@ public:
   void setInitial(vector_RCP & rhs, matrix_RCP & mass, const bool & useadjoint);
 
   void setInitial(vector_RCP & initial, const bool & useadjoint);
+  
+  // ========================================================================================
+  // Lumped (row-sum) mass and the smallest element size (used by the explicit integrators)
+  // ========================================================================================
+  
+  void getLumpedMass(vector_RCP & mass, ScalarT & hmin);
 
   // ========================================================================================
   // ========================================================================================
@@ -114,6 +137,15 @@ public:
                       const int & num_active_params, vector_RCP & Psol,
                       const bool & is_final_time, const int & block);
   
+  // ========================================================================================
+  // Matrix-free action of the Jacobian (J + alpha*Jdot) on an overlapped vector
+  // ========================================================================================
+  
+  void applyJacobian(const vector_RCP & v, const ScalarT & alpha, vector_RCP & Jv);
+  
+  // Identity rows of the strong DBCs in a Jacobian-vector product
+  void applyJacobianDBC(const vector_RCP & v, vector_RCP & Jv);
+  
   
   // ========================================================================================
   //
@@ -134,7 +166,8 @@ public:
   
   void insert(matrix_RCP & J, vector_RCP & res, Kokkos::View<ScalarT***,AssemblyDevice> & local_res,
               Kokkos::View<ScalarT***,AssemblyDevice> & local_J, Kokkos::View<ScalarT***,AssemblyDevice> & local_Jdot,
-              Kokkos::View<GO**,HostDevice> & GIDs, Kokkos::View<GO**,HostDevice> & paramGIDs,
+              Kokkos::View<GO**,HostDevice> & GIDs, Kokkos::View<LO**,HostDevice> & LIDs,
+              Kokkos::View<GO**,HostDevice> & paramGIDs,
               const bool & compute_jacobian, const bool & compute_disc_sens, const ScalarT & alpha);
     
   ///////////////////////////////////////////////////////////////////////////////////////////
@@ -156,8 +189,11 @@ public:
   vector<vector<Teuchos::RCP<BoundaryCell> > > boundaryCells;
   vector<Teuchos::RCP<workset> > wkset;
   
-  bool usestrongDBCs, use_meas_as_dbcs, multiscale, useNewBCs;
+  bool usestrongDBCs, use_meas_as_dbcs, multiscale, useNewBCs, use_local_insert, use_sum_factorization;
+  bool have_dbc_rows = false;
+  vector<Kokkos::View<LO*,HostDevice> > dbc_rows; // per block, local rows on the overlapped map
   Teuchos::RCP<const panzer::DOFManager> DOF;
+  Teuchos::RCP<MultiScale> multiscale_manager; // solves the distributed subgrid problems (set by solver::finalizeMultiscale)
   
 private:
   
@@ -172,6 +208,7 @@ private:
   Teuchos::RCP<Teuchos::Time> dbctimer = Teuchos::TimeMonitor::getNewCounter("MILO::assembly::computeJacRes() - strong Dirichlet BCs");
   Teuchos::RCP<Teuchos::Time> completetimer = Teuchos::TimeMonitor::getNewCounter("MILO::assembly::computeJacRes() - fill complete");
   Teuchos::RCP<Teuchos::Time> msprojtimer = Teuchos::TimeMonitor::getNewCounter("MILO::assembly::computeJacRes() - multiscale projection");
+  Teuchos::RCP<Teuchos::Time> jacvectimer = Teuchos::TimeMonitor::getNewCounter("MILO::assembly::applyJacobian()");
   
 };
 
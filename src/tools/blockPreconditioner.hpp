@@ -0,0 +1,275 @@
+/***********************************************************************
+ Multiscale/Multiphysics Interfaces for Large-scale Optimization (MILO)
+
+ Copyright 2018 National Technology & Engineering Solutions of Sandia,
+ LLC (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the
+ U.S. Government retains certain rights in this software.”
+
+ Questions? Contact Tim Wildey (tmwilde@sandia.gov) and/or
+ Bart van Bloemen Waanders (bartv@sandia.gov)
+ ************************************************************************/
+
+#ifndef BLOCKPRECONDITIONER_H
+#define BLOCKPRECONDITIONER_H
+
+#include "trilinos.hpp"
+#include "preferences.hpp"
+#include "TpetraExt_MatrixMatrix.hpp"
+
+#include <functional>
+
+// Field-split (physics-based) preconditioner for the owned Jacobian
+// The unknowns are split into groups of variables and each diagonal block is handed to
+// its own sub-preconditioner (usually a scalar AMG hierarchy):
+//   "Jacobi"       : block diagonal
+//   "Gauss-Seidel" : block lower triangular (the splits are eliminated in order)
+// For two splits, the second diagonal block can be replaced by an approximate Schur complement
+//   S = A11 - A10 inv(D) A01
+// with D = diag(A00) ("SIMPLE") or the absolute row sums of A00 ("SIMPLEC"), which gives the
+// SIMPLE-type block factorization commonly used for saddle point systems
+
+class BlockPreconditioner : public LA_Operator {
+public:
+
+  typedef std::function<Teuchos::RCP<LA_Operator>(const matrix_RCP &)> subprec_builder;
+
+  BlockPreconditioner() {} ;
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // owned_split gives the split of each owned unknown (local index) or -1 if it is not in a split
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  BlockPreconditioner(const Teuchos::RCP<const LA_Map> & owned_map_,
+                      const vector<int> & owned_split_, const int & numSplits_,
+                      const string & block_type_, const string & schur_type_,
+                      const subprec_builder & builder_) :
+  owned_map(owned_map_), owned_split(owned_split_), numSplits(numSplits_),
+  block_type(block_type_), schur_type(schur_type_), builder(builder_) {
+
+    TEUCHOS_TEST_FOR_EXCEPTION(block_type != "Jacobi" && block_type != "Gauss-Seidel",std::runtime_error,
+                               "Error: unrecognized block preconditioner type: " + block_type);
+    TEUCHOS_TEST_FOR_EXCEPTION(schur_type != "none" && schur_type != "SIMPLE" && schur_type != "SIMPLEC",std::runtime_error,
+                               "Error: unrecognized Schur complement approximation: " + schur_type);
+    TEUCHOS_TEST_FOR_EXCEPTION(schur_type != "none" && numSplits != 2,std::runtime_error,
+                               "Error: the Schur complement approximation requires exactly two splits");
+
+    const Tpetra::global_size_t INVALID = Teuchos::OrdinalTraits<Tpetra::global_size_t>::invalid ();
+
+    // Maps and importers for each split (the splits keep the original GIDs)
+    vector<vector<GO> > split_gids(numSplits);
+    for (size_t i=0; i<owned_split.size(); i++) {
+      if (owned_split[i] >= 0) {
+        split_gids[owned_split[i]].push_back(owned_map->getGlobalElement(i));
+      }
+    }
+    for (int k=0; k<numSplits; k++) {
+      Teuchos::RCP<const LA_Map> kmap = Teuchos::rcp(new LA_Map(INVALID, split_gids[k], 0, owned_map->getComm()));
+      split_maps.push_back(kmap);
+      split_importers.push_back(Teuchos::rcp(new LA_Import(owned_map, kmap)));
+    }
+
+    labels = Teuchos::rcp(new LA_MultiVector(owned_map,1));
+    auto labels_kv = labels->getLocalView<HostDevice>();
+    for (size_t i=0; i<owned_split.size(); i++) {
+      labels_kv(i,0) = owned_split[i];
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Extract the blocks of J and build the sub-preconditioners
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void setup(const matrix_RCP & J) {
+
+    Teuchos::TimeMonitor localtimer(*setuptimer);
+
+    bool use_schur = (schur_type != "none");
+
+    // Split of each column of J
+    Teuchos::RCP<const LA_Map> colmap = J->getColMap();
+    vector_RCP col_labels;
+    Teuchos::RCP<const LA_Import> colimporter = J->getCrsGraph()->getImporter();
+    if (colimporter.is_null()) {
+      col_labels = labels;
+    }
+    else {
+      col_labels = Teuchos::rcp(new LA_MultiVector(colmap,1));
+      col_labels->doImport(*labels, *colimporter, Tpetra::INSERT);
+    }
+    auto col_kv = col_labels->getLocalView<HostDevice>();
+
+    // Only the blocks used in apply() are stored
+    blocks = vector<vector<matrix_RCP> >(numSplits, vector<matrix_RCP>(numSplits));
+    for (int k=0; k<numSplits; k++) {
+      for (int l=0; l<numSplits; l++) {
+        if (l == k || (l < k && (block_type == "Gauss-Seidel" || use_schur)) || (use_schur && k == 0 && l == 1)) {
+          blocks[k][l] = Tpetra::createCrsMatrix<ScalarT>(split_maps[k]);
+        }
+      }
+    }
+
+    // Scaled upper block inv(D)*A01 for the Schur complement (row scaling is local)
+    matrix_RCP DA01;
+    if (use_schur) {
+      DA01 = Tpetra::createCrsMatrix<ScalarT>(split_maps[0]);
+    }
+
+    vector<vector<GO> > rowcols(numSplits);
+    vector<vector<ScalarT> > rowvals(numSplits);
+    for (size_t i=0; i<J->getNodeNumRows(); i++) {
+      int k = owned_split[i];
+      if (k < 0) {
+        continue;
+      }
+      GO rowgid = owned_map->getGlobalElement(i);
+      Teuchos::ArrayView<const LO> indices;
+      Teuchos::ArrayView<const ScalarT> values;
+      J->getLocalRowView(i, indices, values);
+
+      ScalarT dval = 0.0;
+      for (int l=0; l<numSplits; l++) {
+        rowcols[l].clear();
+        rowvals[l].clear();
+      }
+      for (size_t j=0; j<(size_t)indices.size(); j++) {
+        int l = (int)col_kv(indices[j],0);
+        if (l < 0) {
+          continue;
+        }
+        GO colgid = colmap->getGlobalElement(indices[j]);
+        rowcols[l].push_back(colgid);
+        rowvals[l].push_back(values[j]);
+        if (use_schur && k == 0 && l == 0) {
+          if (schur_type == "SIMPLE" && colgid == rowgid) {
+            dval = values[j];
+          }
+          else if (schur_type == "SIMPLEC") {
+            dval += std::abs(values[j]);
+          }
+        }
+      }
+      for (int l=0; l<numSplits; l++) {
+        if (!blocks[k][l].is_null() && rowcols[l].size() > 0) {
+          blocks[k][l]->insertGlobalValues(rowgid, rowcols[l], rowvals[l]);
+        }
+      }
+      if (use_schur && k == 0 && rowcols[1].size() > 0) {
+        TEUCHOS_TEST_FOR_EXCEPTION(dval == 0.0,std::runtime_error,"Error: zero diagonal in the first block of the Schur complement approximation");
+        vector<ScalarT> scaled(rowvals[1].size());
+        for (size_t j=0; j<scaled.size(); j++) {
+          scaled[j] = rowvals[1][j]/dval;
+        }
+        DA01->insertGlobalValues(rowgid, rowcols[1], scaled);
+      }
+    }
+
+    for (int k=0; k<numSplits; k++) {
+      for (int l=0; l<numSplits; l++) {
+        if (!blocks[k][l].is_null()) {
+          blocks[k][l]->fillComplete(split_maps[l], split_maps[k]);
+        }
+      }
+    }
+
+    subprecs.clear();
+    if (use_schur) {
+      DA01->fillComplete(split_maps[1], split_maps[0]);
+      scaled_upper = DA01;
+
+      // S = A11 - A10*inv(D)*A01
+      matrix_RCP BDB = Tpetra::createCrsMatrix<ScalarT>(split_maps[1]);
+      Tpetra::MatrixMatrix::Multiply(*(blocks[1][0]), false, *DA01, false, *BDB);
+      schur = Tpetra::MatrixMatrix::add(1.0, false, *(blocks[1][1]), -1.0, false, *BDB);
+
+      subprecs.push_back(builder(blocks[0][0]));
+      subprecs.push_back(builder(schur));
+    }
+    else {
+      for (int k=0; k<numSplits; k++) {
+        subprecs.push_back(builder(blocks[k][k]));
+      }
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  Teuchos::RCP<const LA_Map> getDomainMap() const {
+    return owned_map;
+  }
+
+  Teuchos::RCP<const LA_Map> getRangeMap() const {
+    return owned_map;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Y = a*inv(P)*X + b*Y
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void apply(const LA_MultiVector & X, LA_MultiVector & Y,
+             Teuchos::ETransp mode = Teuchos::NO_TRANS,
+             ScalarT a = Teuchos::ScalarTraits<ScalarT>::one(),
+             ScalarT b = Teuchos::ScalarTraits<ScalarT>::zero()) const {
+
+    Teuchos::TimeMonitor localtimer(*applytimer);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(mode != Teuchos::NO_TRANS,std::runtime_error,"Error: BlockPreconditioner only supports NO_TRANS");
+
+    size_t numVecs = X.getNumVectors();
+    vector<vector_RCP> r(numSplits), y(numSplits);
+    for (int k=0; k<numSplits; k++) {
+      r[k] = Teuchos::rcp(new LA_MultiVector(split_maps[k],numVecs));
+      r[k]->doImport(X, *(split_importers[k]), Tpetra::INSERT);
+      y[k] = Teuchos::rcp(new LA_MultiVector(split_maps[k],numVecs));
+    }
+
+    if (schur_type != "none") {
+      // Lower solve with the Schur complement, then the upper correction
+      subprecs[0]->apply(*(r[0]), *(y[0]));
+      blocks[1][0]->apply(*(y[0]), *(r[1]), Teuchos::NO_TRANS, -1.0, 1.0);
+      subprecs[1]->apply(*(r[1]), *(y[1]));
+      scaled_upper->apply(*(y[1]), *(y[0]), Teuchos::NO_TRANS, -1.0, 1.0);
+    }
+    else {
+      for (int k=0; k<numSplits; k++) {
+        if (block_type == "Gauss-Seidel") {
+          for (int l=0; l<k; l++) {
+            blocks[k][l]->apply(*(y[l]), *(r[k]), Teuchos::NO_TRANS, -1.0, 1.0);
+          }
+        }
+        subprecs[k]->apply(*(r[k]), *(y[k]));
+      }
+    }
+
+    LA_MultiVector PX(owned_map,numVecs);
+    for (int k=0; k<numSplits; k++) {
+      PX.doExport(*(y[k]), *(split_importers[k]), Tpetra::INSERT);
+    }
+    Y.update(a, PX, b);
+  }
+
+  bool hasTransposeApply() const {
+    return false;
+  }
+
+private:
+
+  Teuchos::RCP<const LA_Map> owned_map;
+  vector<int> owned_split;
+  int numSplits;
+  string block_type, schur_type;
+  subprec_builder builder;
+
+  vector_RCP labels;
+  vector<Teuchos::RCP<const LA_Map> > split_maps;
+  vector<Teuchos::RCP<LA_Import> > split_importers;
+  vector<vector<matrix_RCP> > blocks;
+  matrix_RCP scaled_upper, schur;
+  vector<Teuchos::RCP<LA_Operator> > subprecs;
+
+  Teuchos::RCP<Teuchos::Time> setuptimer = Teuchos::TimeMonitor::getNewCounter("MILO::BlockPreconditioner::setup()");
+  Teuchos::RCP<Teuchos::Time> applytimer = Teuchos::TimeMonitor::getNewCounter("MILO::BlockPreconditioner::apply()");
+
+};
+
+#endif
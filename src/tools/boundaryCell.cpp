@@ -242,6 +242,66 @@ void BoundaryCell::computeJacRes(const ScalarT & time, const bool & isTransient,
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Compute the action of the local Jacobian (J + alpha*Jdot) on a global vector
+///////////////////////////////////////////////////////////////////////////////////////
+
+void BoundaryCell::computeJacVec(const vector_RCP & gl_v, const ScalarT & alpha,
+                                 Kokkos::View<ScalarT***,AssemblyDevice> local_Jv) {
+  
+  // Assumes u has already been gathered for the current state
+  
+  // Seed a single derivative component with the direction v (alpha*v for u_dot), so the
+  // derivative of the AD residual is the Jacobian-vector product
+  
+  Kokkos::View<AD***,AssemblyDevice> u_AD("seeded u",u.extent(0),u.extent(1),u.extent(2));
+  Kokkos::View<AD***,AssemblyDevice> u_dot_AD("seeded u_dot",u.extent(0),u.extent(1),u.extent(2));
+  auto v_kv = gl_v->getLocalView<HostDevice>();
+  
+  parallel_for(RangePolicy<AssemblyDevice>(0,index.extent(0)), KOKKOS_LAMBDA (const int e ) {
+    for (size_t n=0; n<index.extent(1); n++) {
+      for (int i=0; i<numDOF(n); i++) {
+        ScalarT vval = v_kv(index(e,n,i),0);
+        u_AD(e,n,i) = AD(maxDerivs,0,u(e,n,i));
+        u_AD(e,n,i).fastAccessDx(0) = vval;
+        u_dot_AD(e,n,i) = AD(maxDerivs,0,u_dot(e,n,i));
+        u_dot_AD(e,n,i).fastAccessDx(0) = alpha*vval;
+      }
+    }
+  });
+  
+  Kokkos::View<AD***,AssemblyDevice> param_AD("unseeded param",param.extent(0),param.extent(1),param.extent(2));
+  parallel_for(RangePolicy<AssemblyDevice>(0,param.extent(0)), KOKKOS_LAMBDA (const int e ) {
+    for (size_t k=0; k<param.extent(1); k++) {
+      for (size_t i=0; i<param.extent(2); i++) {
+        param_AD(e,k,i) = param(e,k,i);
+      }
+    }
+  });
+  
+  {
+    Teuchos::TimeMonitor localtimer(*boundaryResidualTimer);
+    
+    wkset->updateSide(sidenum, wksetBID);
+    wkset->sidename = sidename;
+    wkset->currentside = sidenum;
+    wkset->computeSolnSideIP(sidenum, u_AD, u_dot_AD, param_AD);
+    
+    wkset->resetResidual(numElem);
+    cellData->physics_RCP->boundaryResidual(cellData->myBlock);
+  }
+  
+  Kokkos::View<AD**,AssemblyDevice> res_AD = wkset->res;
+  Kokkos::View<int**,AssemblyDevice> offsets = wkset->offsets;
+  parallel_for(RangePolicy<AssemblyDevice>(0,local_Jv.extent(0)), KOKKOS_LAMBDA (const int e ) {
+    for (int n=0; n<index.extent(1); n++) {
+      for (int j=0; j<numDOF(n); j++) {
+        local_Jv(e,offsets(n,j),0) += res_AD(e,offsets(n,j)).fastAccessDx(0);
+      }
+    }
+  });
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Use the AD res to update the scalarT res
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -280,7 +340,7 @@ void BoundaryCell::updateAdjointRes(const bool & compute_sens, Kokkos::View<Scal
   Kokkos::View<int**,AssemblyDevice> offsets = wkset->offsets;
   if (compute_sens) {
     parallel_for(RangePolicy<AssemblyDevice>(0,local_res.extent(0)), KOKKOS_LAMBDA (const int e ) {
-      for (int r=0; r<maxDerivs; r++) {
+      for (int r=0; r<local_res.extent(2); r++) {
         for (int n=0; n<index.extent(1); n++) {
           for (int j=0; j<numDOF(n); j++) {
             local_res(e,offsets(n,j),r) -= res_AD(e,offsets(n,j)).fastAccessDx(r);
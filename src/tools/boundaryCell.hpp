@@ -171,6 +171,13 @@ public:
                      Kokkos::View<ScalarT***,AssemblyDevice> local_J,
                      Kokkos::View<ScalarT***,AssemblyDevice> local_Jdot);
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Compute the action of the local Jacobian (J + alpha*Jdot) on a global vector
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeJacVec(const vector_RCP & gl_v, const ScalarT & alpha,
+                     Kokkos::View<ScalarT***,AssemblyDevice> local_Jv);
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   // Use the AD res to update the scalarT res
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -272,6 +279,7 @@ public:
   
   // DOF information
   Kokkos::View<GO**,HostDevice> GIDs, paramGIDs, auxGIDs;
+  Kokkos::View<LO**,HostDevice> LIDs; // same layout as GIDs, local to the overlapped map
   Kokkos::View<LO***,AssemblyDevice> index, paramindex, auxindex;
   Kokkos::View<int*,AssemblyDevice> numDOF, numParamDOF, numAuxDOF;
   Kokkos::View<ScalarT***,AssemblyDevice> u, u_dot, phi, phi_dot, aux;
@@ -131,7 +131,7 @@ void cell::computeSolnVolIP(const bool & seedu, const bool & seedudot, const boo
   
   Teuchos::TimeMonitor localtimer(*computeSolnVolTimer);
   
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   wkset->computeSolnVolIP(u, u_dot, seedu, seedudot);
   wkset->computeParamVolIP(param, seedparams);
   
@@ -166,6 +166,29 @@ void cell::computeSolnVolIP(const bool & seedu, const bool & seedudot, const boo
   
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Update the geometry and basis functions in the workset
+// Unless the cell data is memory efficient, these are computed once and stored in the cell
+// (the boundary cells use the side data stored by workset::addSide, see BoundaryCell::computeJacRes)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void cell::updateWorksetBasis() {
+  
+  if (cellData->memory_efficient) {
+    wkset->update(ip,ijac,orientation);
+  }
+  else if (have_geometry) {
+    wkset->update(ip,geometry);
+  }
+  else {
+    // compute directly into new storage so the workset never writes into another cell's data
+    wkset->update(ip,wkset->allocateVolumeGeometry());
+    wkset->update(ip,ijac,orientation);
+    geometry = wkset->getVolumeGeometry();
+    have_geometry = true;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Update the solution variables in the workset
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -181,10 +204,53 @@ void cell::updateSolnWorkset(const vector_RCP & gl_u, int tindex) {
       }
     }
   }
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   wkset->computeSolnVolIP(ulocal);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Solve the subgrid problems for the elements in this cell
+///////////////////////////////////////////////////////////////////////////////////////
+
+void cell::computeSubgridSolutions(const ScalarT & time, const bool & isTransient, const bool & isAdjoint,
+                                   const bool & compute_jacobian, const bool & compute_sens,
+                                   const int & num_active_params, const bool & compute_disc_sens,
+                                   const bool & compute_aux_sens, const bool & store_adjPrev) {
+  
+  for (int e=0; e<numElem; e++) {
+    int sgindex = subgrid_model_index[e][subgrid_model_index[e].size()-1];
+    double start = Teuchos::Time::wallTime();
+    subgridModels[sgindex]->subgridSolver(u, phi, time, isTransient, isAdjoint,
+                                          compute_jacobian, compute_sens, num_active_params,
+                                          compute_disc_sens, compute_aux_sens,
+                                          *wkset, subgrid_usernum[e], e,
+                                          subgradient, store_adjPrev);
+    this->addSubgridCost(e, Teuchos::Time::wallTime() - start);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Add the subgrid fluxes computed by MultiScale::computeSubgridSolutions
+///////////////////////////////////////////////////////////////////////////////////////
+
+void cell::addSubgridFluxes() {
+  for (int e=0; e<numElem; e++) {
+    for (size_t j=0; j<subgrid_flux.extent(1); j++) {
+      wkset->res(e,j) += subgrid_flux(e,j);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Record the measured time of a subgrid solve (used for load balancing)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void cell::addSubgridCost(const int & e, const ScalarT & solvetime) {
+  if (subgrid_cost.size() == (size_t)numElem) {
+    subgrid_cost[e] += solvetime;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Compute the contribution from this cell to the global res, J, Jdot
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -298,13 +364,12 @@ void cell::computeJacRes(const ScalarT & time, const bool & isTransient, const b
       Teuchos::TimeMonitor localtimer(*volumeResidualTimer);
       cellData->physics_RCP->volumeResidual(cellData->myBlock);
       if (cellData->multiscale) {
-        for (int e=0; e<numElem; e++) {
-          int sgindex = subgrid_model_index[e][subgrid_model_index.size()-1];
-          subgridModels[sgindex]->subgridSolver(u, phi, time, isTransient, isAdjoint,
-                                                compute_jacobian, compute_sens, num_active_params,
-                                                compute_disc_sens, compute_aux_sens,
-                                                *wkset, subgrid_usernum[e], e,
-                                                subgradient, store_adjPrev);
+        if (cellData->subgrid_distributed) {
+          this->addSubgridFluxes();
+        }
+        else {
+          this->computeSubgridSolutions(time, isTransient, isAdjoint, compute_jacobian, compute_sens,
+                                        num_active_params, compute_disc_sens, compute_aux_sens, store_adjPrev);
         }
         fixJacDiag = true;
       }
@@ -491,6 +556,58 @@ void cell::computeJacRes(const ScalarT & time, const bool & isTransient, const b
   
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Compute the action of the local Jacobian (J + alpha*Jdot) on a global vector
+///////////////////////////////////////////////////////////////////////////////////////
+
+void cell::computeJacVec(const vector_RCP & gl_v, const ScalarT & alpha,
+                         Kokkos::View<ScalarT***,AssemblyDevice> local_Jv) {
+  
+  // Assumes u and u_dot have already been gathered for the current state
+  
+  // Seed a single derivative component with the direction v (alpha*v for u_dot), so the
+  // derivative of the AD residual is the Jacobian-vector product
+  
+  Kokkos::View<AD***,AssemblyDevice> u_AD("seeded u",u.extent(0),u.extent(1),u.extent(2));
+  Kokkos::View<AD***,AssemblyDevice> u_dot_AD("seeded u_dot",u.extent(0),u.extent(1),u.extent(2));
+  auto v_kv = gl_v->getLocalView<HostDevice>();
+  
+  parallel_for(RangePolicy<AssemblyDevice>(0,index.extent(0)), KOKKOS_LAMBDA (const int e ) {
+    for (size_t n=0; n<index.extent(1); n++) {
+      for (int i=0; i<numDOF(n); i++) {
+        ScalarT vval = v_kv(index(e,n,i),0);
+        u_AD(e,n,i) = AD(maxDerivs,0,u(e,n,i));
+        u_AD(e,n,i).fastAccessDx(0) = vval;
+        u_dot_AD(e,n,i) = AD(maxDerivs,0,u_dot(e,n,i));
+        u_dot_AD(e,n,i).fastAccessDx(0) = alpha*vval;
+      }
+    }
+  });
+  
+  {
+    Teuchos::TimeMonitor localtimer(*computeSolnVolTimer);
+    this->updateWorksetBasis();
+    wkset->computeSolnVolIP(u_AD, u_dot_AD);
+    wkset->computeParamVolIP(param, false);
+  }
+  
+  {
+    Teuchos::TimeMonitor localtimer(*volumeResidualTimer);
+    wkset->resetResidual();
+    cellData->physics_RCP->volumeResidual(cellData->myBlock);
+  }
+  
+  Kokkos::View<AD**,AssemblyDevice> res_AD = wkset->res;
+  Kokkos::View<int**,AssemblyDevice> offsets = wkset->offsets;
+  parallel_for(RangePolicy<AssemblyDevice>(0,local_Jv.extent(0)), KOKKOS_LAMBDA (const int e ) {
+    for (int n=0; n<index.extent(1); n++) {
+      for (int j=0; j<numDOF(n); j++) {
+        local_Jv(e,offsets(n,j),0) += res_AD(e,offsets(n,j)).fastAccessDx(0);
+      }
+    }
+  });
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Use the AD res to update the scalarT res
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -529,7 +646,7 @@ void cell::updateAdjointRes(const bool & compute_sens, Kokkos::View<ScalarT***,A
   Kokkos::View<int**,AssemblyDevice> offsets = wkset->offsets;
   if (compute_sens) {
     parallel_for(RangePolicy<AssemblyDevice>(0,local_res.extent(0)), KOKKOS_LAMBDA (const int e ) {
-      for (int r=0; r<maxDerivs; r++) {
+      for (int r=0; r<local_res.extent(2); r++) {
         for (int n=0; n<index.extent(1); n++) {
           for (int j=0; j<numDOF(n); j++) {
             local_res(e,offsets(n,j),r) -= res_AD(e,offsets(n,j)).fastAccessDx(r);
@@ -734,7 +851,7 @@ void cell::updateAuxJacDot(Kokkos::View<ScalarT***,AssemblyDevice> local_Jdot) {
 
 Kokkos::View<ScalarT**,AssemblyDevice> cell::getInitial(const bool & project, const bool & isAdjoint) {
   Kokkos::View<ScalarT**,AssemblyDevice> initialvals("initial values",numElem,GIDs.extent(1));
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   if (project) { // works for any basis
     for (int n=0; n<wkset->varlist.size(); n++) {
       Kokkos::View<ScalarT**,AssemblyDevice> initialip = cellData->physics_RCP->getInitial(wkset->ip,
@@ -774,7 +891,7 @@ Kokkos::View<ScalarT**,AssemblyDevice> cell::getInitial(const bool & project, co
 
 Kokkos::View<ScalarT***,AssemblyDevice> cell::getMass() {
   Kokkos::View<ScalarT***,AssemblyDevice> mass("local mass",numElem,GIDs.extent(1), GIDs.extent(1));
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   vector<string> basis_types = wkset->basis_types;
   
   parallel_for(RangePolicy<AssemblyDevice>(0,mass.extent(0)), KOKKOS_LAMBDA (const int e ) {
@@ -810,7 +927,7 @@ Kokkos::View<ScalarT**,AssemblyDevice> cell::computeError(const ScalarT & solvet
   
   Kokkos::View<ScalarT**,AssemblyDevice> errors("errors",numElem,index.extent(1));
   if (!compute_subgrid) {
-    wkset->update(ip,ijac,orientation);
+    this->updateWorksetBasis();
     wkset->computeSolnVolIP(u, u_dot, false, false);
     size_t numip = wkset->numip;
     
@@ -907,7 +1024,7 @@ Kokkos::View<AD***,AssemblyDevice> cell::computeResponseAtNodes(const DRV & node
   // TMW: this whole function needs to be rewritten to use worksets properly
   /*
    size_t numip = nodes.extent(1);
-   wkset->update(ip,ijac,orientation);
+   this->updateWorksetBasis();
    
    // Map the local solution to the solution and gradient at ip
    FCAD u_ip(numElem,index[0].size(),numip);
@@ -969,7 +1086,7 @@ Kokkos::View<AD***,AssemblyDevice> cell::computeResponse(const ScalarT & solveti
     numip = sensorLocations.size();
   }
   
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   
   //KokkosTools::print(u);
   if (numip > 0) {
@@ -1287,7 +1404,7 @@ AD cell::computeDomainRegularization(const vector<ScalarT> reg_constants, const
   //}
   //this->setLocalADParams(param_AD,seedParams);
   int numip = wkset->numip;
-  wkset->update(ip,ijac,orientation);
+  this->updateWorksetBasis();
   wkset->computeParamVolIP(param, seedParams);
   
   AD p, dpdx, dpdy, dpdz; // parameters
@@ -44,6 +44,7 @@ public:
     numElem = nodes.extent(0);
     active = true;
     useSensors = false;
+    have_geometry = false;
     
   }
   
@@ -58,6 +59,7 @@ public:
     ijac = DRV("ijac", numElem, ref_ip.extent(0), cellData->dimension, cellData->dimension);
     CellTools<AssemblyDevice>::setJacobian(ijac, ref_ip, nodes, *(cellData->cellTopo));
     
+    have_geometry = false; // any stored basis functions are out of date
   }
   
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -179,6 +181,12 @@ public:
   void computeSolnVolIP(const bool & seedu, const bool & seedudot, const bool & seedparams,
                         const bool & seedaux);
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Update the geometry and basis functions in the workset
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void updateWorksetBasis();
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   // Compute the contribution from this cell to the global res, J, Jdot
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -191,6 +199,32 @@ public:
                      Kokkos::View<ScalarT***,AssemblyDevice> local_J,
                      Kokkos::View<ScalarT***,AssemblyDevice> local_Jdot);
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Solve the subgrid problems for the elements in this cell (adds the fluxes to the
+  // workset residual)
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeSubgridSolutions(const ScalarT & time, const bool & isTransient, const bool & isAdjoint,
+                               const bool & compute_jacobian, const bool & compute_sens,
+                               const int & num_active_params, const bool & compute_disc_sens,
+                               const bool & compute_aux_sens, const bool & store_adjPrev);
+  
+  void addSubgridCost(const int & e, const ScalarT & solvetime);
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Add the subgrid fluxes computed by MultiScale::computeSubgridSolutions to the
+  // workset residual
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void addSubgridFluxes();
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Compute the action of the local Jacobian (J + alpha*Jdot) on a global vector
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeJacVec(const vector_RCP & gl_v, const ScalarT & alpha,
+                     Kokkos::View<ScalarT***,AssemblyDevice> local_Jv);
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   // Update the solution variables in the workset
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -393,12 +427,15 @@ public:
   // Geometry Information
   int numElem;
   DRV nodes, ip, ijac;
+  VolumeGeometry geometry; // stored basis functions (unless cellData->memory_efficient)
+  bool have_geometry;
   //vector<DRV> sideip, sideijac, normals, sidewts;
   Kokkos::View<int****,HostDevice> sideinfo; // may need to move this to Assembly
   vector<string> sidenames;
   
   // DOF information
   Kokkos::View<GO**,HostDevice> GIDs, paramGIDs, auxGIDs;
+  Kokkos::View<LO**,HostDevice> LIDs; // same layout as GIDs, local to the overlapped map
   Kokkos::View<LO***,AssemblyDevice> index, paramindex, auxindex;
   vector<vector<ScalarT> > orientation;
   Kokkos::View<int*,AssemblyDevice> numDOF, numParamDOF, numAuxDOF;
@@ -408,6 +445,9 @@ public:
   vector<Teuchos::RCP<SubGridModel> > subgridModels;
   vector<size_t> subgrid_usernum, cell_data_seed, cell_data_seedindex;
   vector<vector<size_t> > subgrid_model_index;
+  vector<ScalarT> subgrid_cost; // measured subgrid solve time (s) for each element since the last model update
+  vector<int> subgrid_rank; // rank that solves the subgrid problem of each element
+  Kokkos::View<AD**,AssemblyDevice> subgrid_flux; // subgrid contribution to the workset residual
   
   // Discretized Parameter Information
   Kokkos::View<ScalarT***,AssemblyDevice> param;
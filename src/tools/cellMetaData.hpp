@@ -42,6 +42,7 @@ public:
     mortar_objective = settings->sublist("Solver").get<bool>("Use Mortar Objective",false);
     
     multiscale = false;
+    subgrid_distributed = false;
     numnodes = cellTopo->getNodeCount();
     dimension = cellTopo->getDimension();
     
@@ -75,6 +76,7 @@ public:
   bool mortar_objective;
   bool exodus_sensors = false;
   bool multiscale, have_cell_phi, have_cell_rotation;
+  bool subgrid_distributed; // subgrid fluxes are computed before the cell loop (MultiScale::computeSubgridSolutions)
   
 };
 
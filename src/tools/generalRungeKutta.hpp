@@ -16,7 +16,8 @@
 #include "preferences.hpp"
 #include "timeIntegrator.hpp"
 
-// Base class for time integration methods in MILO
+// Runge-Kutta methods defined by a Butcher tableau
+// The diagonally implicit methods are solved one stage at a time by solver::rungeKuttaStep
 
 class RungeKutta : public TimeIntegrator {
 public:
@@ -34,7 +35,9 @@ public:
   ///////////////////////////////////////////////////////////////////////////////////////
   
   RungeKutta(const string method_, const size_t & order_, const bool & sol_staggered_) :
-  method(method_), order(order_), sol_staggered(sol_staggered_) {
+  method(method_), order(order_) {
+    sol_staggered = sol_staggered_;
+
     // Define the Butcher tableau and the number os stages based on the method and order
     if (method == "Explicit") {
       if (order == 1) { // Forward Euler
@@ -58,6 +61,35 @@ public:
         btab_b(0) = 1.0/6.0; btab_b(1) = 1.0/3.0; btab_b(2) = 1.0/3.0; btab_b(3) = 1.0/6.0;
         btab_c(0) = 0.0; btab_c(1) = 0.5; btab_c(2) = 0.5; btab_c(3) = 1.0;
       }
+      else {
+        TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: unrecognized Runge-Kutta method.");
+      }
+    }
+    else if (method == "SSP") { // Strong stability preserving (Shu and Osher)
+      if (order == 2) {
+        num_stages = 2;
+        btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
+        btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
+        btab_c = Kokkos::View<ScalarT*,HostDevice>("butcher tableau c",num_stages);
+        btab_a(0,0) = 0.0; btab_a(0,1) = 0.0;
+        btab_a(1,0) = 1.0; btab_a(1,1) = 0.0;
+        btab_b(0) = 0.5; btab_b(1) = 0.5;
+        btab_c(0) = 0.0; btab_c(1) = 1.0;
+      }
+      else if (order == 3) {
+        num_stages = 3;
+        btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
+        btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
+        btab_c = Kokkos::View<ScalarT*,HostDevice>("butcher tableau c",num_stages);
+        btab_a(0,0) = 0.0;  btab_a(0,1) = 0.0;  btab_a(0,2) = 0.0;
+        btab_a(1,0) = 1.0;  btab_a(1,1) = 0.0;  btab_a(1,2) = 0.0;
+        btab_a(2,0) = 0.25; btab_a(2,1) = 0.25; btab_a(2,2) = 0.0;
+        btab_b(0) = 1.0/6.0; btab_b(1) = 1.0/6.0; btab_b(2) = 2.0/3.0;
+        btab_c(0) = 0.0; btab_c(1) = 1.0; btab_c(2) = 0.5;
+      }
+      else {
+        TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: unrecognized Runge-Kutta method.");
+      }
     }
     else if (method == "Embedded") {
       if (order == 5) { // RK45
@@ -65,6 +97,7 @@ public:
         btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
         btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
         btab_c = Kokkos::View<ScalarT*,HostDevice>("butcher tableau c",num_stages);
+        btab_bs = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b star",num_stages);
         btab_a(0,0) = 0.0;           btab_a(0,1) = 0.0;            btab_a(0,2) = 0.0;            btab_a(0,3) = 0.0;           btab_a(0,4) = 0.0;        btab_a(0,5) = 0.0;
         btab_a(1,0) = 0.25;          btab_a(1,1) = 0.0;            btab_a(1,2) = 0.0;            btab_a(1,3) = 0.0;           btab_a(1,4) = 0.0;        btab_a(1,5) = 0.0;
         btab_a(2,0) = 3.0/32.0;      btab_a(2,1) = 9.0/32.0;       btab_a(2,2) = 0.0;            btab_a(2,3) = 0.0;           btab_a(2,4) = 0.0;        btab_a(2,5) = 0.0;
@@ -82,7 +115,7 @@ public:
         TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: unrecognized Runge-Kutta method.");
       }
     }
-    else if (method == "DIRK") { // Diagonally Implicit RK
+    else if (method == "DIRK" || method == "SDIRK") { // (Singly) Diagonally Implicit RK
       if (order == 1) { // Backward Euler
         num_stages = 1;
         btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
@@ -103,6 +136,35 @@ public:
         btab_b(0) = 1.0-gamma; btab_b(1) = gamma;
         btab_c(0) = gamma; btab_c(1) = 1.0;
       }
+      else if (order == 3) { // L-stable, stiffly accurate SDIRK (Alexander)
+        num_stages = 3;
+        btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
+        btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
+        btab_c = Kokkos::View<ScalarT*,HostDevice>("butcher tableau c",num_stages);
+        ScalarT gamma = 0.4358665215084590;
+        ScalarT b1 = -(6.0*gamma*gamma - 16.0*gamma + 1.0)/4.0;
+        ScalarT b2 = (6.0*gamma*gamma - 20.0*gamma + 5.0)/4.0;
+        btab_a(0,0) = gamma;            btab_a(0,1) = 0.0;   btab_a(0,2) = 0.0;
+        btab_a(1,0) = (1.0-gamma)/2.0;  btab_a(1,1) = gamma; btab_a(1,2) = 0.0;
+        btab_a(2,0) = b1;               btab_a(2,1) = b2;    btab_a(2,2) = gamma;
+        btab_b(0) = b1; btab_b(1) = b2; btab_b(2) = gamma;
+        btab_c(0) = gamma; btab_c(1) = (1.0+gamma)/2.0; btab_c(2) = 1.0;
+      }
+      else if (order == 4) { // L-stable, stiffly accurate 5-stage SDIRK (Hairer and Wanner)
+        num_stages = 5;
+        btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
+        btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
+        btab_c = Kokkos::View<ScalarT*,HostDevice>("butcher tableau c",num_stages);
+        btab_a(0,0) = 0.25;
+        btab_a(1,0) = 0.5;             btab_a(1,1) = 0.25;
+        btab_a(2,0) = 17.0/50.0;       btab_a(2,1) = -1.0/25.0;     btab_a(2,2) = 0.25;
+        btab_a(3,0) = 371.0/1360.0;    btab_a(3,1) = -137.0/2720.0; btab_a(3,2) = 15.0/544.0;  btab_a(3,3) = 0.25;
+        btab_a(4,0) = 25.0/24.0;       btab_a(4,1) = -49.0/48.0;    btab_a(4,2) = 125.0/16.0;  btab_a(4,3) = -85.0/12.0; btab_a(4,4) = 0.25;
+        for (size_t j=0; j<num_stages; j++) {
+          btab_b(j) = btab_a(4,j);
+        }
+        btab_c(0) = 0.25; btab_c(1) = 0.75; btab_c(2) = 11.0/20.0; btab_c(3) = 0.5; btab_c(4) = 1.0;
+      }
       else {
         TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: unrecognized Runge-Kutta method.");
       }
@@ -117,7 +179,7 @@ public:
         btab_b(0) = 1.0;
         btab_c(0) = 1.0;
       }
-      if (order == 2) { // Midpoint rule
+      else if (order == 2) { // Midpoint rule
         num_stages = 1;
         btab_a = Kokkos::View<ScalarT**,HostDevice>("butcher tableau a",num_stages,num_stages);
         btab_b = Kokkos::View<ScalarT*,HostDevice>("butcher tableau b",num_stages);
@@ -173,6 +235,89 @@ public:
     }
   }
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Combine the stage time derivatives to compute the end-node solution
+  // sol = u_prev + dt*sum_j b_j*K_j
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeSolution(vector_RCP & u_prev, vector<vector_RCP> & stage_dot, const ScalarT & deltat,
+                       vector_RCP & sol) {
+    sol->update(1.0, *u_prev, 0.0);
+    for (size_t j=0; j<num_stages; j++) {
+      if (btab_b(j) != 0.0) {
+        sol->update(deltat*btab_b(j), *(stage_dot[j]), 1.0);
+      }
+    }
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Explicit part of a stage solution for a diagonally implicit method
+  // base = u_prev + dt*sum_{j<snum} a_{snum,j}*K_j, so U_snum = base + dt*a_{snum,snum}*K_snum
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeStageBase(vector_RCP & u_prev, vector<vector_RCP> & stage_dot, const size_t & snum,
+                        const ScalarT & deltat, vector_RCP & base) {
+    base->update(1.0, *u_prev, 0.0);
+    for (size_t j=0; j<snum; j++) {
+      if (btab_a(snum,j) != 0.0) {
+        base->update(deltat*btab_a(snum,j), *(stage_dot[j]), 1.0);
+      }
+    }
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Coefficient on the stage time derivative (dK/dU) in the stage Jacobian
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  ScalarT computeStageAlpha(const size_t & snum, const ScalarT & deltat) {
+    return 1.0/(btab_a(snum,snum)*deltat);
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Properties of the tableau
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  bool isDiagonallyImplicit() {
+    bool isdirk = true;
+    for (size_t i=0; i<num_stages; i++) {
+      if (btab_a(i,i) == 0.0) {
+        isdirk = false;
+      }
+      for (size_t j=i+1; j<num_stages; j++) {
+        if (btab_a(i,j) != 0.0) {
+          isdirk = false;
+        }
+      }
+    }
+    return isdirk;
+  }
+  
+  bool isExplicit() {
+    bool isexplicit = true;
+    for (size_t i=0; i<num_stages; i++) {
+      for (size_t j=i; j<num_stages; j++) {
+        if (btab_a(i,j) != 0.0) {
+          isexplicit = false;
+        }
+      }
+    }
+    return isexplicit;
+  }
+  
+  bool isStifflyAccurate() { // the last stage is the end-node solution
+    bool issa = (std::abs(btab_c(num_stages-1) - 1.0) < 1.0e-14);
+    for (size_t j=0; j<num_stages; j++) {
+      if (std::abs(btab_b(j) - btab_a(num_stages-1,j)) > 1.0e-14) {
+        issa = false;
+      }
+    }
+    return issa;
+  }
+  
+  bool isBackwardEuler() {
+    return (num_stages == 1 && btab_a(0,0) == 1.0 && btab_b(0) == 1.0);
+  }
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   // Compute the stage time
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,163 @@
+/***********************************************************************
+ Multiscale/Multiphysics Interfaces for Large-scale Optimization (MILO)
+
+ Copyright 2018 National Technology & Engineering Solutions of Sandia,
+ LLC (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the
+ U.S. Government retains certain rights in this software.”
+
+ Questions? Contact Tim Wildey (tmwilde@sandia.gov) and/or
+ Bart van Bloemen Waanders (bartv@sandia.gov)
+ ************************************************************************/
+
+#ifndef JACOBIANOPERATOR_H
+#define JACOBIANOPERATOR_H
+
+#include "trilinos.hpp"
+#include "preferences.hpp"
+#include "assemblyManager.hpp"
+
+#include <functional>
+
+// Matrix-free Jacobian (J + alpha*Jdot) on the owned map
+// The action is either a finite difference of the residual in the direction v
+//   J*v = (F(u + eps*v, u_dot + alpha*eps*v) - F(u, u_dot))/eps
+// using the residual callback (one residual assembly per apply), or the AD directional
+// derivative from AssemblyManager::applyJacobian (the full AD type is seeded, so this costs
+// about as much as assembling J). Either way, it is only valid at the state set by setState
+
+class MatrixFreeJacobian : public LA_Operator {
+public:
+
+  MatrixFreeJacobian() {} ;
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  MatrixFreeJacobian(Teuchos::RCP<AssemblyManager> & assembler_,
+                     const Teuchos::RCP<const LA_Map> & owned_map_,
+                     const Teuchos::RCP<const LA_Map> & overlapped_map_,
+                     const Teuchos::RCP<LA_Export> & exporter_,
+                     const Teuchos::RCP<LA_Import> & importer_) :
+  assembler(assembler_), owned_map(owned_map_), overlapped_map(overlapped_map_),
+  exporter(exporter_), importer(importer_) {
+
+    alpha = 0.0;
+    v_over = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
+    Jv_over = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
+    Jv = Teuchos::rcp(new LA_MultiVector(owned_map,1));
+
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  Teuchos::RCP<const LA_Map> getDomainMap() const {
+    return owned_map;
+  }
+
+  Teuchos::RCP<const LA_Map> getRangeMap() const {
+    return owned_map;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Y = a*J*X + b*Y
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void apply(const LA_MultiVector & X, LA_MultiVector & Y,
+             Teuchos::ETransp mode = Teuchos::NO_TRANS,
+             ScalarT a = Teuchos::ScalarTraits<ScalarT>::one(),
+             ScalarT b = Teuchos::ScalarTraits<ScalarT>::zero()) const {
+
+    Teuchos::TimeMonitor localtimer(*applytimer);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(mode != Teuchos::NO_TRANS,std::runtime_error,"Error: MatrixFreeJacobian only supports NO_TRANS");
+
+    for (size_t k=0; k<X.getNumVectors(); k++) {
+      v_over->putScalar(0.0);
+      v_over->doImport(*(X.getVector(k)), *importer, Tpetra::INSERT);
+
+      Jv_over->putScalar(0.0);
+      if (use_fd) {
+        this->applyFD();
+      }
+      else {
+        assembler->applyJacobian(v_over, alpha, Jv_over);
+      }
+
+      Jv->putScalar(0.0);
+      Jv->doExport(*Jv_over, *exporter, Tpetra::ADD);
+
+      Y.getVectorNonConst(k)->update(a, *(Jv->getVector(0)), b);
+    }
+  }
+
+  bool hasTransposeApply() const {
+    return false;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Finite difference product for v_over (result in Jv_over)
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void applyFD() const {
+
+    TEUCHOS_TEST_FOR_EXCEPTION(!residual || u.is_null(),std::runtime_error,"Error: the finite difference Jacobian-vector product requires the state and residual callback to be set");
+
+    Teuchos::Array<typename Teuchos::ScalarTraits<ScalarT>::magnitudeType> vnorm(1);
+    v_over->norm2(vnorm);
+    if (vnorm[0] == 0.0) {
+      return;
+    }
+    // Usual choice of the perturbation for Newton-Krylov
+    ScalarT eps = std::sqrt(Teuchos::ScalarTraits<ScalarT>::eps())*(1.0 + u_norm)/vnorm[0];
+
+    u_pert->update(1.0, *u, eps, *v_over, 0.0);
+    u_dot_pert->update(1.0, *u_dot, alpha*eps, *v_over, 0.0);
+    res_pert->putScalar(0.0);
+    residual(u_pert, u_dot_pert, res_pert);
+
+    // res = -F, so J*v = -(res(u+eps*v) - res(u))/eps
+    Jv_over->update(-1.0/eps, *res_pert, 1.0/eps, *res0_over, 0.0);
+    assembler->applyJacobianDBC(v_over, Jv_over);
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // State for the finite difference product: u, u_dot (overlapped) and the overlapped
+  // residual at that state (same sign convention as assembleJacRes, i.e., -F)
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void setState(const vector_RCP & u_, const vector_RCP & u_dot_, const vector_RCP & res_over_) {
+    u = u_;
+    u_dot = u_dot_;
+    res0_over = res_over_;
+    if (u_pert.is_null()) {
+      u_pert = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
+      u_dot_pert = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
+      res_pert = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
+    }
+    Teuchos::Array<typename Teuchos::ScalarTraits<ScalarT>::magnitudeType> unorm(1);
+    u->norm2(unorm);
+    u_norm = unorm[0];
+  }
+
+  typedef std::function<void(vector_RCP &, vector_RCP &, vector_RCP &)> residual_evaluator;
+
+  ScalarT alpha; // coefficient on Jdot (same as in assembleJacRes)
+  bool use_fd = true;
+  residual_evaluator residual; // (u, u_dot, res_over), adds into res_over
+
+private:
+
+  Teuchos::RCP<AssemblyManager> assembler;
+  Teuchos::RCP<const LA_Map> owned_map, overlapped_map;
+  Teuchos::RCP<LA_Export> exporter;
+  Teuchos::RCP<LA_Import> importer;
+  mutable vector_RCP v_over, Jv_over, Jv;
+  vector_RCP u, u_dot, res0_over, u_pert, u_dot_pert, res_pert;
+  ScalarT u_norm = 0.0;
+
+  Teuchos::RCP<Teuchos::Time> applytimer = Teuchos::TimeMonitor::getNewCounter("MILO::MatrixFreeJacobian::apply()");
+
+};
+
+#endif
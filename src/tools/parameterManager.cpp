@@ -170,7 +170,7 @@ void ParameterManager::setupParameters(Teuchos::RCP<Teuchos::ParameterList> & se
       pl_itr++;
     }
     
-    TEUCHOS_TEST_FOR_EXCEPTION(num_active_params > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameters.");
+    TEUCHOS_TEST_FOR_EXCEPTION(num_active_params > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameters.  Reconfigure with a larger MILO_MAX_DERIVS.");
     
     size_t maxcomp = 0;
     for (size_t k=0; k<paramvals.size(); k++) {
@@ -348,7 +348,7 @@ void ParameterManager::setupDiscretizedParameters(vector<vector<Teuchos::RCP<cel
       for(size_t e=0; e<cells[b].size(); e++) {
         gids = cells[b][e]->paramGIDs;
         // this should fail on the first iteration through if maxDerivs is not large enough
-        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameter degrees of freedom per element.");
+        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameter degrees of freedom per element.  Reconfigure with a larger MILO_MAX_DERIVS.");
         
         int numElem = cells[b][e]->numElem;
         Kokkos::View<LO***,AssemblyDevice> cellindices("Local DOF indices", numElem,
@@ -385,7 +385,7 @@ void ParameterManager::setupDiscretizedParameters(vector<vector<Teuchos::RCP<cel
       for(size_t e=0; e<boundaryCells[b].size(); e++) {
         gids = boundaryCells[b][e]->paramGIDs;
         // this should fail on the first iteration through if maxDerivs is not large enough
-        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameter degrees of freedom per element.");
+        TEUCHOS_TEST_FOR_EXCEPTION(gids.extent(1) > maxDerivs,std::runtime_error,"Error: maxDerivs is not large enough to support the number of parameter degrees of freedom per element.  Reconfigure with a larger MILO_MAX_DERIVS.");
         
         int numElem = boundaryCells[b][e]->numElem;
         Kokkos::View<LO***,AssemblyDevice> cellindices("Local DOF indices", numElem,
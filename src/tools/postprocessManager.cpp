@@ -375,7 +375,7 @@ Kokkos::View<ScalarT***,HostDevice> PostprocessManager::computeResponse(const in
     assembler->performGather(b,P_soln,4,0);
     
     for (size_t e=0; e<cells[b].size(); e++) {
-      assembler->wkset[b]->update(cells[b][e]->ip, cells[b][e]->ijac, cells[b][e]->orientation);
+      cells[b][e]->updateWorksetBasis();
       
       Kokkos::View<AD***,AssemblyDevice> responsevals = cells[b][e]->computeResponse(solvetimes[tt], tt, 0);
       
@@ -1094,6 +1094,9 @@ vector<ScalarT> PostprocessManager::computeParameterSensitivities() {
     cout << "***** Computing Sensitivities ******" << endl << endl;
   }
   
+  // The loop below needs the forward state at every time step
+  TEUCHOS_TEST_FOR_EXCEPTION(solve->isTransient && solve->checkpoint_storage > 0,std::runtime_error,"Error: computeParameterSensitivities requires every forward state, so it cannot be used with checkpoint storage");
+  
   vector_RCP u = Teuchos::rcp(new LA_MultiVector(solve->LA_overlapped_map,1)); // forward solution
   vector_RCP phi = Teuchos::rcp(new LA_MultiVector(solve->LA_overlapped_map,1)); // forward solution
   vector_RCP a2 = Teuchos::rcp(new LA_MultiVector(solve->LA_owned_map,1)); // adjoint solution
@@ -0,0 +1,115 @@
+/***********************************************************************
+ Multiscale/Multiphysics Interfaces for Large-scale Optimization (MILO)
+
+ Copyright 2018 National Technology & Engineering Solutions of Sandia,
+ LLC (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the
+ U.S. Government retains certain rights in this software.”
+
+ Questions? Contact Tim Wildey (tmwilde@sandia.gov) and/or
+ Bart van Bloemen Waanders (bartv@sandia.gov)
+ ************************************************************************/
+
+#ifndef SINGLEPRECISIONPRECONDITIONER_H
+#define SINGLEPRECISIONPRECONDITIONER_H
+
+#include "trilinos.hpp"
+#include "preferences.hpp"
+
+#include <MueLu.hpp>
+#include <MueLu_TpetraOperator.hpp>
+#include <MueLu_CreateTpetraPreconditioner.hpp>
+
+#ifdef MILO_HAVE_SINGLE_PRECISION
+
+// MueLu preconditioner built and applied in single precision
+// The matrix is copied to float when the hierarchy is built (or reused) and the vectors are
+// converted on every apply, so the outer Krylov method stays in double precision
+// The preconditioner is only accurate to single precision, so it should be used as a
+// right preconditioner with flexible GMRES
+
+class SinglePrecisionPreconditioner : public LA_Operator {
+public:
+
+  SinglePrecisionPreconditioner() {} ;
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  SinglePrecisionPreconditioner(const matrix_RCP & J, Teuchos::ParameterList & mueluParams) {
+
+    Teuchos::TimeMonitor localtimer(*setuptimer);
+
+    domain_map = J->getDomainMap();
+    range_map = J->getRangeMap();
+    J_sp = J->convert<PrecScalarT>();
+    M_sp = MueLu::CreateTpetraPreconditioner((Teuchos::RCP<LA_Operator_sp>)J_sp, mueluParams);
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Recompute the hierarchy for new values of J (see MueLu::ReuseTpetraPreconditioner)
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void reuse(const matrix_RCP & J) {
+
+    Teuchos::TimeMonitor localtimer(*setuptimer);
+
+    J_sp = J->convert<PrecScalarT>();
+    MueLu::ReuseTpetraPreconditioner(J_sp, *M_sp);
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  Teuchos::RCP<const LA_Map> getDomainMap() const {
+    return domain_map;
+  }
+
+  Teuchos::RCP<const LA_Map> getRangeMap() const {
+    return range_map;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Y = a*inv(P)*X + b*Y
+  ///////////////////////////////////////////////////////////////////////////////////////
+
+  void apply(const LA_MultiVector & X, LA_MultiVector & Y,
+             Teuchos::ETransp mode = Teuchos::NO_TRANS,
+             ScalarT a = Teuchos::ScalarTraits<ScalarT>::one(),
+             ScalarT b = Teuchos::ScalarTraits<ScalarT>::zero()) const {
+
+    Teuchos::TimeMonitor localtimer(*applytimer);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(mode != Teuchos::NO_TRANS,std::runtime_error,"Error: SinglePrecisionPreconditioner only supports NO_TRANS");
+
+    if (X_sp.is_null() || X_sp->getNumVectors() != X.getNumVectors()) {
+      X_sp = Teuchos::rcp(new LA_MultiVector_sp(domain_map, X.getNumVectors()));
+      Y_sp = Teuchos::rcp(new LA_MultiVector_sp(range_map, X.getNumVectors()));
+      PX = Teuchos::rcp(new LA_MultiVector(range_map, X.getNumVectors()));
+    }
+
+    Tpetra::deep_copy(*X_sp, X);
+    M_sp->apply(*X_sp, *Y_sp);
+    Tpetra::deep_copy(*PX, *Y_sp);
+    Y.update(a, *PX, b);
+  }
+
+  bool hasTransposeApply() const {
+    return false;
+  }
+
+private:
+
+  Teuchos::RCP<const LA_Map> domain_map, range_map;
+  Teuchos::RCP<LA_CrsMatrix_sp> J_sp;
+  Teuchos::RCP<MueLu::TpetraOperator<PrecScalarT, LO, GO, HostNode> > M_sp;
+  mutable Teuchos::RCP<LA_MultiVector_sp> X_sp, Y_sp;
+  mutable vector_RCP PX;
+
+  Teuchos::RCP<Teuchos::Time> setuptimer = Teuchos::TimeMonitor::getNewCounter("MILO::SinglePrecisionPreconditioner::setup()");
+  Teuchos::RCP<Teuchos::Time> applytimer = Teuchos::TimeMonitor::getNewCounter("MILO::SinglePrecisionPreconditioner::apply()");
+
+};
+
+#endif // MILO_HAVE_SINGLE_PRECISION
+
+#endif
@@ -14,6 +14,9 @@
 
 #include "trilinos.hpp"
 #include "preferences.hpp"
+#include <fstream>
+#include <algorithm>
+#include <list>
 // Add includes for PyTorch
 
 
@@ -22,7 +25,11 @@ template<class V>
 class SolutionStorage {
 public:
   
-  SolutionStorage() {} ;
+  SolutionStorage() {
+    out_of_core = false;
+    compression_tol = 0.0;
+    storage_id = 0;
+  } ;
   
   ///////////////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -33,6 +40,29 @@ public:
     maxStorage = settings->sublist("Solver").get<LO>("maximum storage", 100);
     timeTOL = settings->sublist("Solver").get<ScalarT>("storage time tol", 1.0e-13);
     
+    // Out-of-core storage: only the maxStorage most recently used vectors stay in memory
+    // and the others are written to a single binary file per rank
+    string backend = settings->sublist("Solver").get<string>("storage backend","memory"); // or "disk"
+    TEUCHOS_TEST_FOR_EXCEPTION(backend != "memory" && backend != "disk",std::runtime_error,"Error: MILO does not recognize the storage backend: " + backend);
+    out_of_core = (backend == "disk");
+    storage_dir = settings->sublist("Solver").get<string>("storage directory",".");
+    // Vectors that can be stored in single precision with a relative error below this tolerance
+    // are written to disk in single precision (0 = always write full precision)
+    compression_tol = settings->sublist("Solver").get<ScalarT>("storage compression tolerance",0.0);
+    
+    static int numstorage = 0;
+    storage_id = numstorage++;
+    
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  ~SolutionStorage() {
+    if (!file.is_null()) {
+      file->close();
+      std::remove(this->filename().c_str());
+    }
   }
   
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -45,7 +75,7 @@ public:
     bool found = false;
     if (data.size()>0) {
       if (data[0].size()>timeindex) {
-        vec = data[0][timeindex];
+        vec = this->getData(0,timeindex);
         found = true;
       }
     }
@@ -53,16 +83,15 @@ public:
   }
   
   ///////////////////////////////////////////////////////////////////////////////////////
+  // Extract by position (separate name so it cannot be confused with the time lookup)
   ///////////////////////////////////////////////////////////////////////////////////////
   
-  bool extract(Teuchos::RCP<V> & vec, const size_t & timeindex, const size_t & index) {
-    // defaults to index = 0
-    // most common use case
+  bool extractByIndex(Teuchos::RCP<V> & vec, const size_t & timeindex, const size_t & index) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
     bool found = false;
     if (data.size()>index) {
       if (data[index].size()>timeindex) {
-        vec = data[index][timeindex];
+        vec = this->getData(index,timeindex);
         found = true;
       }
     }
@@ -74,12 +103,10 @@ public:
 
   bool extract(Teuchos::RCP<V> & vec, const size_t & index, const ScalarT & currtime) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
-    bool found = false;
-    for (size_t j=0; j<times[index].size(); j++) {
-      if (abs(times[index][j] - currtime) < timeTOL) {
-        vec = data[index][j];
-        found = true;
-      }
+    size_t j;
+    bool found = this->findTime(index, currtime, j);
+    if (found) {
+      vec = this->getData(index,j);
     }
     return found;
   }
@@ -89,13 +116,11 @@ public:
   
   bool extract(Teuchos::RCP<V> & vec, const size_t & index, const ScalarT & currtime, int & timeindex) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
-    bool found = false;
-    for (size_t j=0; j<times[index].size(); j++) {
-      if (abs(times[index][j] - currtime) < timeTOL) {
-        vec = data[index][j];
-        timeindex = j;
-        found = true;
-      }
+    size_t j;
+    bool found = this->findTime(index, currtime, j);
+    if (found) {
+      vec = this->getData(index,j);
+      timeindex = j;
     }
     return found;
   }
@@ -105,19 +130,14 @@ public:
   
   bool extractPrevious(Teuchos::RCP<V> & vec, const size_t & index, const ScalarT & currtime, ScalarT & prevtime) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
-    bool found = false;
-    for (size_t j=0; j<times[index].size(); j++) {
-      if (abs(times[index][j] - currtime) < timeTOL) {
-        found = true;
-        if (j>0) {
-          vec = data[index][j-1];
-          prevtime = times[index][j-1];
-        }
-        else {
-          vec = data[index][j];
-          prevtime = times[index][j];
-        }
+    size_t j;
+    bool found = this->findTime(index, currtime, j);
+    if (found) {
+      if (j>0) {
+        j--;
       }
+      vec = this->getData(index,j);
+      prevtime = times[index][j];
     }
     return found;
   }
@@ -127,19 +147,14 @@ public:
   
   bool extractNext(Teuchos::RCP<V> & vec, const size_t & index, const ScalarT & currtime, ScalarT & nexttime) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
-    bool found = false;
-    for (size_t j=0; j<times[index].size(); j++) {
-      if (abs(times[index][j] - currtime) < timeTOL) {
-        found = true;
-        if (j<(times[index].size()-1)) {
-          vec = data[index][j+1];
-          nexttime = times[index][j+1];
-        }
-        else {
-          vec = data[index][j];
-          nexttime = times[index][j];
-        }
+    size_t j;
+    bool found = this->findTime(index, currtime, j);
+    if (found) {
+      if (j<(times[index].size()-1)) {
+        j++;
       }
+      vec = this->getData(index,j);
+      nexttime = times[index][j];
     }
     return found;
   }
@@ -150,7 +165,7 @@ public:
   bool extractLast(Teuchos::RCP<V> & vec, const size_t & index, ScalarT & lasttime) {
     Teuchos::TimeMonitor localtimer(*solnStorageExtractTimer);
     bool found = true;
-    vec = data[index][times[index].size()-1];
+    vec = this->getData(index,times[index].size()-1);
     lasttime = times[index][times[index].size()-1];
     return found;
   }
@@ -166,30 +181,118 @@ public:
     Teuchos::RCP<V> vecstore = copyData(newvec);
     
     
-    if (times.size() <= index) {
-      vector<ScalarT> newtime = {currtime};
-      vector<Teuchos::RCP<V> > newdata = {vecstore};
-      times.push_back(newtime);
-      data.push_back(newdata);
+    while (times.size() <= index) {
+      times.push_back(vector<ScalarT>());
+      data.push_back(vector<Teuchos::RCP<V> >());
+      offsets.push_back(vector<std::streamoff>());
+      capacity.push_back(vector<size_t>());
+      lru_pos.push_back(vector<typename std::list<lru_entry>::iterator>());
+      cursor.push_back(0);
+      is_sorted.push_back(true);
+    }
+    
+    size_t timeindex;
+    bool foundtime = this->findTime(index, currtime, timeindex);
+    if (foundtime) {
+      data[index][timeindex] = vecstore;
     }
     else {
-      size_t timeindex;
-      bool foundtime = false;
-      for (size_t j=0; j<times[index].size(); j++) {
-        if (abs(times[index][j] - currtime) < timeTOL) {
-          foundtime = true;
-          timeindex = j;
-        }
+      if (times[index].size() > 0 && currtime < times[index].back()) {
+        is_sorted[index] = false;
+      }
+      data[index].push_back(vecstore);
+      times[index].push_back(currtime);
+      offsets[index].push_back(-1);
+      capacity[index].push_back(0);
+      lru_pos[index].push_back(lru.end());
+      timeindex = times[index].size()-1;
+    }
+    
+    if (out_of_core) {
+      this->touch(index, timeindex);
+      this->enforceStorage();
+    }
+    
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Remove the data stored at a given time (used to free checkpoints)
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void erase(const size_t & index, const ScalarT & currtime) {
+    size_t j;
+    if (this->findTime(index, currtime, j)) {
+      if (lru_pos[index][j] != lru.end()) {
+        lru.erase(lru_pos[index][j]);
       }
-      if (foundtime) {
-        data[index][timeindex] = vecstore;
+      if (offsets[index][j] >= 0) {
+        free_records.push_back(std::make_pair(offsets[index][j], capacity[index][j]));
       }
-      else {
-        data[index].push_back(vecstore);
-        times[index].push_back(currtime);
+      times[index].erase(times[index].begin()+j);
+      data[index].erase(data[index].begin()+j);
+      offsets[index].erase(offsets[index].begin()+j);
+      capacity[index].erase(capacity[index].begin()+j);
+      lru_pos[index].erase(lru_pos[index].begin()+j);
+      cursor[index] = 0;
+    }
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Find the position of a stored time
+  // Checks the last position found (and its neighbors) first, since most callers step
+  // through the times in order, then uses a binary search if the times are increasing
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  bool findTime(const size_t & index, const ScalarT & currtime, size_t & timeindex) {
+    if (times.size() <= index) {
+      return false;
+    }
+    const vector<ScalarT> & currtimes = times[index];
+    size_t numtimes = currtimes.size();
+    if (numtimes == 0) {
+      return false;
+    }
+    
+    size_t c = cursor[index];
+    size_t first = (c > 0) ? c-1 : 0;
+    size_t last = std::min(c+2, numtimes);
+    for (size_t j=first; j<last; j++) {
+      if (abs(currtimes[j] - currtime) < timeTOL) {
+        timeindex = j;
+        cursor[index] = j;
+        return true;
       }
     }
     
+    if (is_sorted[index]) {
+      typename vector<ScalarT>::const_iterator it = std::lower_bound(currtimes.begin(), currtimes.end(), currtime - timeTOL);
+      if (it != currtimes.end() && abs(*it - currtime) < timeTOL) {
+        timeindex = it - currtimes.begin();
+        cursor[index] = timeindex;
+        return true;
+      }
+    }
+    else {
+      for (size_t j=0; j<numtimes; j++) {
+        if (abs(currtimes[j] - currtime) < timeTOL) {
+          timeindex = j;
+          cursor[index] = j;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  size_t getNumTimes(const size_t & index) {
+    size_t numtimes = 0;
+    if (times.size() > index) {
+      numtimes = times[index].size();
+    }
+    return numtimes;
   }
   
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -214,6 +317,220 @@ public:
   }
   
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Access to the stored data (reads the vector back from disk if it was spilled)
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  Teuchos::RCP<V> getData(const size_t & index, const size_t & timeindex) {
+    if (data[index][timeindex].is_null()) {
+      this->readData(index, timeindex);
+    }
+    if (out_of_core) {
+      this->touch(index, timeindex);
+      this->enforceStorage();
+    }
+    return data[index][timeindex];
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Move a resident vector to the front of the LRU list
+  // Entries are keyed on the time since erase() shifts the positions in times[index]
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void touch(const size_t & index, const size_t & timeindex) {
+    if (lru_pos[index][timeindex] != lru.end()) {
+      lru.erase(lru_pos[index][timeindex]);
+    }
+    lru.push_front(lru_entry(index, times[index][timeindex]));
+    lru_pos[index][timeindex] = lru.begin();
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Spill the least recently used vectors until at most maxStorage are in memory
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void enforceStorage() {
+    if (!out_of_core) {
+      return;
+    }
+    while (lru.size() > (size_t)std::max(maxStorage,1)) {
+      size_t oldk = lru.back().first, oldj = 0;
+      bool found = this->findTime(oldk, lru.back().second, oldj);
+      TEUCHOS_TEST_FOR_EXCEPTION(!found,std::runtime_error,"Error: MILO lost track of a stored solution");
+      lru.pop_back();
+      lru_pos[oldk][oldj] = lru.end();
+      this->writeData(oldk, oldj);
+    }
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Each record is: number of entries, number of vectors, precision flag, then the values
+  // in the stored precision.  A record is rewritten in place if it fits, otherwise it is
+  // moved to a free record (or the end of the file) and its old space is recycled.
+  // The vector is always rewritten since extract hands out the stored vector itself
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void writeData(const size_t & index, const size_t & timeindex) {
+    
+    Teuchos::TimeMonitor localtimer(*solnStorageSpillTimer);
+    
+    typedef typename HostNode::device_type V_device;
+    
+    Teuchos::RCP<V> vec = data[index][timeindex];
+    auto vec_kv = vec->template getLocalView<V_device>();
+    size_t numentries = vec_kv.extent(0);
+    size_t numvecs = vec_kv.extent(1);
+    
+    this->openFile(index, vec);
+    
+    // check if single precision is accurate enough
+    int single = 0;
+    if (compression_tol > 0.0) {
+      ScalarT maxval = 0.0, maxerr = 0.0;
+      for (size_t i=0; i<numentries; i++) {
+        for (size_t n=0; n<numvecs; n++) {
+          ScalarT val = vec_kv(i,n);
+          maxval = std::max(maxval, std::abs(val));
+          maxerr = std::max(maxerr, std::abs(val - (ScalarT)((float)val)));
+        }
+      }
+      if (maxerr <= compression_tol*maxval) {
+        single = 1;
+      }
+    }
+    
+    vector<float> fbuffer;
+    vector<ScalarT> buffer;
+    const char * values;
+    size_t numbytes;
+    if (single == 1) {
+      fbuffer = vector<float>(numentries*numvecs, 0.0);
+      for (size_t i=0; i<numentries; i++) {
+        for (size_t n=0; n<numvecs; n++) {
+          fbuffer[n*numentries+i] = (float)vec_kv(i,n);
+        }
+      }
+      values = reinterpret_cast<const char*>(fbuffer.data());
+      numbytes = fbuffer.size()*sizeof(float);
+    }
+    else {
+      buffer = vector<ScalarT>(numentries*numvecs, 0.0);
+      for (size_t i=0; i<numentries; i++) {
+        for (size_t n=0; n<numvecs; n++) {
+          buffer[n*numentries+i] = vec_kv(i,n);
+        }
+      }
+      values = reinterpret_cast<const char*>(buffer.data());
+      numbytes = buffer.size()*sizeof(ScalarT);
+    }
+    size_t recordsize = 2*sizeof(size_t) + sizeof(int) + numbytes;
+    
+    if (offsets[index][timeindex] < 0 || capacity[index][timeindex] < recordsize) {
+      if (offsets[index][timeindex] >= 0) {
+        free_records.push_back(std::make_pair(offsets[index][timeindex], capacity[index][timeindex]));
+      }
+      this->allocateRecord(recordsize, offsets[index][timeindex], capacity[index][timeindex]);
+    }
+    
+    file->seekp(offsets[index][timeindex]);
+    file->write(reinterpret_cast<const char*>(&numentries), sizeof(size_t));
+    file->write(reinterpret_cast<const char*>(&numvecs), sizeof(size_t));
+    file->write(reinterpret_cast<const char*>(&single), sizeof(int));
+    file->write(values, numbytes);
+    file->flush();
+    TEUCHOS_TEST_FOR_EXCEPTION(!file->good(),std::runtime_error,"Error: MILO could not write to the solution storage file: " + this->filename());
+    
+    data[index][timeindex] = Teuchos::null;
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Find space for a record: the first free record that is large enough, else the end
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void allocateRecord(const size_t & recordsize, std::streamoff & offset, size_t & recordcapacity) {
+    for (size_t k=0; k<free_records.size(); k++) {
+      if (free_records[k].second >= recordsize) {
+        offset = free_records[k].first;
+        recordcapacity = free_records[k].second;
+        free_records.erase(free_records.begin()+k);
+        return;
+      }
+    }
+    offset = file_end;
+    recordcapacity = recordsize;
+    file_end += recordsize;
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void readData(const size_t & index, const size_t & timeindex) {
+    
+    Teuchos::TimeMonitor localtimer(*solnStorageSpillTimer);
+    
+    typedef typename HostNode::device_type V_device;
+    
+    TEUCHOS_TEST_FOR_EXCEPTION(offsets[index][timeindex] < 0 || file.is_null(),std::runtime_error,"Error: MILO could not find a stored solution on disk");
+    
+    size_t numentries = 0, numvecs = 0;
+    int single = 0;
+    file->seekg(offsets[index][timeindex]);
+    file->read(reinterpret_cast<char*>(&numentries), sizeof(size_t));
+    file->read(reinterpret_cast<char*>(&numvecs), sizeof(size_t));
+    file->read(reinterpret_cast<char*>(&single), sizeof(int));
+    
+    Teuchos::RCP<V> vec = Teuchos::rcp( new V(maps[index],numvecs));
+    auto vec_kv = vec->template getLocalView<V_device>();
+    if (single == 1) {
+      vector<float> fbuffer(numentries*numvecs, 0.0);
+      file->read(reinterpret_cast<char*>(fbuffer.data()), fbuffer.size()*sizeof(float));
+      for (size_t i=0; i<numentries; i++) {
+        for (size_t n=0; n<numvecs; n++) {
+          vec_kv(i,n) = fbuffer[n*numentries+i];
+        }
+      }
+    }
+    else {
+      vector<ScalarT> buffer(numentries*numvecs, 0.0);
+      file->read(reinterpret_cast<char*>(buffer.data()), buffer.size()*sizeof(ScalarT));
+      for (size_t i=0; i<numentries; i++) {
+        for (size_t n=0; n<numvecs; n++) {
+          vec_kv(i,n) = buffer[n*numentries+i];
+        }
+      }
+    }
+    TEUCHOS_TEST_FOR_EXCEPTION(!file->good(),std::runtime_error,"Error: MILO could not read from the solution storage file: " + this->filename());
+    data[index][timeindex] = vec;
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // One file per storage object and rank; the map is recorded for each index
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void openFile(const size_t & index, Teuchos::RCP<V> & vec) {
+    while (maps.size() <= index) {
+      maps.push_back(Teuchos::null);
+    }
+    if (maps[index].is_null()) {
+      maps[index] = vec->getMap();
+    }
+    if (file.is_null()) {
+      // The subgrid maps are on a local communicator, so the file name uses the global rank
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      file = Teuchos::rcp(new std::fstream(this->filename().c_str(),
+                                           std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc));
+      TEUCHOS_TEST_FOR_EXCEPTION(!file->is_open(),std::runtime_error,"Error: MILO could not open the solution storage file: " + this->filename());
+      file_end = 0;
+    }
+  }
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  string filename() {
+    return storage_dir + "/milo_storage." + std::to_string(storage_id) + "." + std::to_string(rank) + ".bin";
+  }
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////
   
@@ -237,7 +554,24 @@ public:
   ScalarT timeTOL;
   
   vector<vector<ScalarT> > times;
-  vector<vector<Teuchos::RCP<V> > > data;
+  vector<size_t> cursor; // last position found in times[index]
+  vector<bool> is_sorted; // true if times[index] is increasing
+  vector<vector<Teuchos::RCP<V> > > data; // null if the vector has been spilled to disk
+  
+  // Out-of-core storage
+  bool out_of_core;
+  string storage_dir;
+  ScalarT compression_tol;
+  int storage_id, rank = 0;
+  typedef std::pair<size_t,ScalarT> lru_entry; // (index, time)
+  std::list<lru_entry> lru; // resident vectors, most recently used first
+  vector<vector<typename std::list<lru_entry>::iterator> > lru_pos; // lru.end() if not resident
+  vector<vector<std::streamoff> > offsets; // location in the file (-1 if never written)
+  vector<vector<size_t> > capacity; // bytes reserved for the record
+  vector<std::pair<std::streamoff,size_t> > free_records; // (offset, bytes) of released records
+  std::streamoff file_end = 0;
+  Teuchos::RCP<std::fstream> file;
+  vector<Teuchos::RCP<const typename V::map_type> > maps;
   
   // Additional data needed for ML
   vector<vector<Kokkos::View<ScalarT*,AssemblyDevice> > > inputs;
@@ -248,6 +582,7 @@ public:
   // Timers
   Teuchos::RCP<Teuchos::Time> solnStorageStoreTimer = Teuchos::TimeMonitor::getNewCounter("MILO::SolutionStorage::store");
   Teuchos::RCP<Teuchos::Time> solnStorageExtractTimer = Teuchos::TimeMonitor::getNewCounter("MILO::SolutionStorage::extract");
+  Teuchos::RCP<Teuchos::Time> solnStorageSpillTimer = Teuchos::TimeMonitor::getNewCounter("MILO::SolutionStorage::disk I/O");
   Teuchos::RCP<Teuchos::Time> solnStorageTrainDNNTimer = Teuchos::TimeMonitor::getNewCounter("MILO::SolutionStorage::trainDNN");
   Teuchos::RCP<Teuchos::Time> solnStorageUseDNNTimer = Teuchos::TimeMonitor::getNewCounter("MILO::SolutionStorage::useDNN");
   
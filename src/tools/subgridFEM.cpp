@@ -47,6 +47,19 @@ num_macro_time_steps(num_macro_time_steps_), macro_deltat(macro_deltat_) {
   sub_NLtol = settings->sublist("Solver").get<ScalarT>("NLtol",1.0E-12);
   sub_maxNLiter = settings->sublist("Solver").get<int>("MaxNLiter",10);
   useDirect = settings->sublist("Solver").get<bool>("use direct solver",true);
+  factor_reuse = settings->sublist("Solver").get<bool>("factorization reuse",false);
+  factor_reuse_max = settings->sublist("Solver").get<int>("factorization reuse count",10);
+  factor_reuse_reduction = settings->sublist("Solver").get<ScalarT>("factorization reuse reduction",0.5);
+  initial_guess = settings->sublist("Solver").get<string>("initial guess","previous");
+  extrap_order = settings->sublist("Solver").get<int>("extrapolation order",1);
+  TEUCHOS_TEST_FOR_EXCEPTION(initial_guess != "previous" && initial_guess != "last iterate" && initial_guess != "extrapolate",std::runtime_error,"Error: unrecognized subgrid initial guess: " + initial_guess);
+  TEUCHOS_TEST_FOR_EXCEPTION(extrap_order < 1 || extrap_order > 2,std::runtime_error,"Error: the subgrid extrapolation order must be 1 or 2");
+  ref_resnorm = 0.0;
+  last_resnorm_initial = 0.0;
+  useDense = settings->sublist("Solver").get<bool>("use dense subgrid solver",false);
+  TEUCHOS_TEST_FOR_EXCEPTION(useDense && LocalComm->getSize() > 1,std::runtime_error,"Error: the dense subgrid solver requires each subgrid problem to be on a single processor");
+  // The dense solver stores an N x N factor for every usernum, so it is limited to small subgrids
+  dense_max_size = settings->sublist("Solver").get<int>("dense subgrid solver max size",400);
   
   /////////////////////////////////////////////////////////////////////////////////////
   // Define the sub-grid physics
@@ -102,6 +115,13 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
     first_time = true;
   }
   
+  // Reuse the usernum of a released macro-element
+  int block = cells.size();
+  if (free_usernums.size() > 0) {
+    block = free_usernums.back();
+    free_usernums.pop_back();
+  }
+  
   /////////////////////////////////////////////////////////////////////////////////////
   // Define the sub-grid mesh
   /////////////////////////////////////////////////////////////////////////////////////
@@ -110,8 +130,14 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
   Teuchos::TimeMonitor localmeshtimer(*sgfemTotalAddMacroTimer);
   
   // Use the macro-element nodes to create the initial sub-grid element
-  macronodes.push_back(macronodes_);
-  macrosideinfo.push_back(macrosideinfo_);
+  if (block < (int)macronodes.size()) {
+    macronodes[block] = macronodes_;
+    macrosideinfo[block] = macrosideinfo_;
+  }
+  else {
+    macronodes.push_back(macronodes_);
+    macrosideinfo.push_back(macrosideinfo_);
+  }
   vector<vector<ScalarT> > nodes;
   vector<vector<int> > connectivity;
   Kokkos::View<int****,HostDevice> sideinfo;
@@ -315,7 +341,12 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
         }
       }
     }
-    subgridbcs.push_back(currbcs);
+    if (block < (int)subgridbcs.size()) {
+      subgridbcs[block] = currbcs;
+    }
+    else {
+      subgridbcs.push_back(currbcs);
+    }
     
     for (size_t s=0; s<unique_sides.size(); s++) {
       
@@ -403,9 +434,11 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
         currcells[0][e]->setIP(disc->ref_ip[0]);
         //currcells[0][e]->setSideIP(disc->ref_side_ip[0], disc->ref_side_wts[0]);
         currcells[0][e]->GIDs = cells[0][e]->GIDs;
+        currcells[0][e]->LIDs = cells[0][e]->LIDs;
       }
       for (size_t e=0; e<bCells[0].size(); e++) {
         bCells[0][e]->GIDs = boundaryCells[0][e]->GIDs;
+        bCells[0][e]->LIDs = boundaryCells[0][e]->LIDs;
       }
     }
   }
@@ -473,8 +506,7 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
     overlapped_map = sub_solver->LA_overlapped_map;
     exporter = sub_solver->exporter;
     importer = sub_solver->importer;
-    owned_graph = sub_solver->LA_owned_graph;
-    owned_graph->fillComplete();
+    owned_graph = sub_solver->LA_owned_graph; // already fill complete
     
     overlapped_graph = sub_solver->LA_overlapped_graph;
     
@@ -556,10 +588,14 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
     
   }
   
-  cells.push_back(currcells[0]);
-  boundaryCells.push_back(bCells[0]);
-  
-  int block = cells.size()-1;
+  if (block < (int)cells.size()) {
+    cells[block] = currcells[0];
+    boundaryCells[block] = bCells[0];
+  }
+  else {
+    cells.push_back(currcells[0]);
+    boundaryCells.push_back(bCells[0]);
+  }
   
   //////////////////////////////////////////////////////////////
   // Set the initial conditions
@@ -686,7 +722,7 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
       }
     }
     
-    if (block == 0) { // first time through
+    if (first_time) {
       wkset[0]->addAux(macro_varlist.size());
     }
     for(size_t e=0; e<boundaryCells[block].size(); e++) {
@@ -708,7 +744,264 @@ int SubGridFEM::addMacro(const DRV macronodes_, Kokkos::View<int****,HostDevice>
 ////////////////////////////////////////////////////////////////////////////////
 
 void SubGridFEM::finalize() {
-  // nothing to do here
+  
+  // All of the usernums are known now, so the dense factors are allocated once
+  if (useDense && cells.size() > 0) {
+    this->allocateDenseFactors(cells.size());
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Stored solutions that subgridSolver reads for a usernum: the forward solutions up to the
+// current time (enough of the history for the initial guess) and, for the sensitivities,
+// the adjoint solutions at the current and next times.
+// The rank that solves the element replaces its copy of these with unpackState.
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::packState(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                           vector<ScalarT> & buffer) {
+  
+  // The previous step and the extrapolation history (in time order), then the current time
+  vector<size_t> fwdindex = this->historyIndex(usernum, time, extrap_order+1);
+  vector<size_t> adjindex;
+  size_t j;
+  if (soln->findTime(usernum, time, j)) {
+    fwdindex.push_back(j);
+  }
+  size_t numtimes = soln->getNumTimes(usernum);
+  if (numtimes > 0 && std::find(fwdindex.begin(), fwdindex.end(), numtimes-1) == fwdindex.end()) {
+    fwdindex.push_back(numtimes-1); // steady-state solves start from the last solution
+  }
+  if (compute_sens) {
+    if (adjsoln->findTime(usernum, time, j)) {
+      adjindex.push_back(j);
+      if (j+1 < adjsoln->getNumTimes(usernum)) {
+        adjindex.push_back(j+1);
+      }
+    }
+  }
+  this->packStorage(soln, usernum, fwdindex, buffer);
+  this->packStorage(adjsoln, usernum, adjindex, buffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::unpackState(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) {
+  
+  vector<ScalarT> oldtimes;
+  if (soln->getNumTimes(usernum) > 0) {
+    oldtimes = soln->times[usernum];
+  }
+  for (size_t j=0; j<oldtimes.size(); j++) {
+    soln->erase(usernum, oldtimes[j]);
+  }
+  this->unpackStorage(soln, usernum, buffer, pos);
+  
+  oldtimes.clear();
+  if (adjsoln->getNumTimes(usernum) > 0) {
+    oldtimes = adjsoln->times[usernum];
+  }
+  for (size_t j=0; j<oldtimes.size(); j++) {
+    adjsoln->erase(usernum, oldtimes[j]);
+  }
+  this->unpackStorage(adjsoln, usernum, buffer, pos);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// The solution stored by subgridSolver (none for the sensitivities)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::packResult(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                            vector<ScalarT> & buffer) {
+  vector<size_t> fwdindex;
+  size_t j;
+  if (!compute_sens && soln->findTime(usernum, time, j)) {
+    fwdindex.push_back(j);
+  }
+  this->packStorage(soln, usernum, fwdindex, buffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::unpackResult(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) {
+  this->unpackStorage(soln, usernum, buffer, pos);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Each stored vector is: time, number of entries, number of vectors, then the values
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::packStorage(Teuchos::RCP<SolutionStorage<LA_MultiVector> > & storage, const int & usernum,
+                             const vector<size_t> & timeindex, vector<ScalarT> & buffer) {
+  buffer.push_back(timeindex.size());
+  for (size_t k=0; k<timeindex.size(); k++) {
+    Teuchos::RCP<LA_MultiVector> vec = storage->getData(usernum, timeindex[k]);
+    auto vec_kv = vec->getLocalView<HostDevice>();
+    buffer.push_back(storage->times[usernum][timeindex[k]]);
+    buffer.push_back(vec_kv.extent(0));
+    buffer.push_back(vec_kv.extent(1));
+    for (size_t j=0; j<vec_kv.extent(1); j++) {
+      for (size_t i=0; i<vec_kv.extent(0); i++) {
+        buffer.push_back(vec_kv(i,j));
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::unpackStorage(Teuchos::RCP<SolutionStorage<LA_MultiVector> > & storage, const int & usernum,
+                               const vector<ScalarT> & buffer, size_t & pos) {
+  size_t numstored = buffer[pos++];
+  for (size_t k=0; k<numstored; k++) {
+    ScalarT time = buffer[pos++];
+    size_t numentries = buffer[pos++];
+    size_t numvecs = buffer[pos++];
+    TEUCHOS_TEST_FOR_EXCEPTION(numentries != overlapped_map->getNodeNumElements(),std::runtime_error,"Error: the subgrid solution received from another rank does not match the local subgrid map");
+    Teuchos::RCP<LA_MultiVector> vec = Teuchos::rcp(new LA_MultiVector(overlapped_map,numvecs));
+    auto vec_kv = vec->getLocalView<HostDevice>();
+    for (size_t j=0; j<numvecs; j++) {
+      for (size_t i=0; i<numentries; i++) {
+        vec_kv(i,j) = buffer[pos++];
+      }
+    }
+    storage->store(vec, time, usernum);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Release a macro-element
+// The stored solutions and the cached solver data are freed, and the usernum is reused by
+// the next call to addMacro (the sub-grid cells are replaced then)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::removeMacro(const int & usernum) {
+  
+  vector<ScalarT> oldtimes;
+  if (soln->getNumTimes(usernum) > 0) {
+    oldtimes = soln->times[usernum];
+  }
+  for (size_t j=0; j<oldtimes.size(); j++) {
+    soln->erase(usernum, oldtimes[j]);
+  }
+  oldtimes.clear();
+  if (adjsoln->getNumTimes(usernum) > 0) {
+    oldtimes = adjsoln->times[usernum];
+  }
+  for (size_t j=0; j<oldtimes.size(); j++) {
+    adjsoln->erase(usernum, oldtimes[j]);
+  }
+  
+  if (factor_age.size() > (size_t)usernum) {
+    factor_cache[usernum] = Teuchos::null;
+    prec_cache[usernum] = Teuchos::null;
+    factor_age[usernum] = 0;
+    factor_current[usernum] = false;
+  }
+  if (dense_factored.size() > (size_t)usernum) {
+    dense_factored[usernum] = false;
+  }
+  if (guess_cache.size() > (size_t)usernum) {
+    guess_cache[usernum].clear();
+    guess_refnorm[usernum].clear();
+  }
+  free_usernums.push_back(usernum);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Remove the solutions and iterates computed at a rejected macro time
+// Otherwise, the next step would extrapolate from (or reuse) the rejected states
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::eraseTime(const ScalarT & time) {
+  for (size_t usernum=0; usernum<soln->times.size(); usernum++) {
+    soln->erase(usernum, time);
+  }
+  for (size_t usernum=0; usernum<guess_time.size(); usernum++) {
+    if (abs(guess_time[usernum] - time) < 1.0e-12) {
+      guess_cache[usernum].clear();
+      guess_refnorm[usernum].clear();
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// The mesh data set by addMeshData for each sub-grid cell of a usernum
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::packCellData(const int & usernum, vector<ScalarT> & buffer) {
+  buffer.push_back(cells[usernum].size());
+  for (size_t e=0; e<cells[usernum].size(); e++) {
+    Teuchos::RCP<cell> ccell = cells[usernum][e];
+    buffer.push_back(ccell->cellData->have_cell_rotation);
+    buffer.push_back(ccell->cellData->have_cell_phi);
+    buffer.push_back(ccell->cell_data.extent(0));
+    buffer.push_back(ccell->cell_data.extent(1));
+    for (size_t i=0; i<ccell->cell_data.extent(0); i++) {
+      for (size_t j=0; j<ccell->cell_data.extent(1); j++) {
+        buffer.push_back(ccell->cell_data(i,j));
+      }
+    }
+    buffer.push_back(ccell->cell_data_distance.size());
+    for (size_t i=0; i<ccell->cell_data_distance.size(); i++) {
+      buffer.push_back(ccell->cell_data_distance[i]);
+      buffer.push_back(ccell->cell_data_seed[i]);
+      buffer.push_back(ccell->cell_data_seedindex[i]);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::unpackCellData(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) {
+  size_t numcells = buffer[pos++];
+  TEUCHOS_TEST_FOR_EXCEPTION(numcells != cells[usernum].size(),std::runtime_error,"Error: the subgrid mesh data received from another rank does not match the local subgrid cells");
+  for (size_t e=0; e<numcells; e++) {
+    Teuchos::RCP<cell> ccell = cells[usernum][e];
+    ccell->cellData->have_cell_rotation = buffer[pos++];
+    ccell->cellData->have_cell_phi = buffer[pos++];
+    size_t n1 = buffer[pos++], n2 = buffer[pos++];
+    ccell->cell_data = Kokkos::View<ScalarT**,HostDevice>("cell_data",n1,n2);
+    for (size_t i=0; i<n1; i++) {
+      for (size_t j=0; j<n2; j++) {
+        ccell->cell_data(i,j) = buffer[pos++];
+      }
+    }
+    size_t numdist = buffer[pos++];
+    ccell->cell_data_distance = vector<ScalarT>(numdist);
+    ccell->cell_data_seed = vector<size_t>(numdist);
+    ccell->cell_data_seedindex = vector<size_t>(numdist);
+    for (size_t i=0; i<numdist; i++) {
+      ccell->cell_data_distance[i] = buffer[pos++];
+      ccell->cell_data_seed[i] = buffer[pos++];
+      ccell->cell_data_seedindex[i] = buffer[pos++];
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Allocate (or grow) the dense factors for numusers usernums
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::allocateDenseFactors(const size_t & numusers) {
+  
+  size_t N = owned_map->getNodeNumElements();
+  TEUCHOS_TEST_FOR_EXCEPTION(N > (size_t)dense_max_size,std::runtime_error,"Error: the subgrid problems have " + std::to_string(N) + " unknowns, which is larger than the dense subgrid solver max size (" + std::to_string(dense_max_size) + ")");
+  
+  if (dense_LU.extent(0) != N) {
+    dense_LU = Kokkos::View<ScalarT***,Kokkos::LayoutLeft,HostDevice>("dense subgrid LU",N,N,numusers);
+    dense_piv = Kokkos::View<int**,Kokkos::LayoutLeft,HostDevice>("dense subgrid pivots",N,numusers);
+    dense_factored = vector<bool>(numusers,false);
+  }
+  else if (dense_LU.extent(2) < numusers) {
+    Kokkos::resize(dense_LU,N,N,numusers);
+    Kokkos::resize(dense_piv,N,numusers);
+    dense_factored.resize(numusers,false);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1136,6 +1429,9 @@ void SubGridFEM::subgridSolver(Kokkos::View<ScalarT***,AssemblyDevice> gl_u,
     else { // forward or compute sens
       if (isTransient) {
         bool foundfwd = soln->extractPrevious(u, usernum, current_time, prev_time);
+        if (!foundfwd && numtimes > 0) { // first macro iteration of a step
+          foundfwd = soln->extractLast(u,usernum,prev_time);
+        }
       }
       else {
         bool foundfwd = soln->extractLast(u,usernum,prev_time);
@@ -1230,6 +1526,24 @@ void SubGridFEM::subgridSolver(Kokkos::View<ScalarT***,AssemblyDevice> gl_u,
       }
     }
     else {
+      
+      // Solution history for extrapolating the initial guess (most recent last)
+      // u is copied so the warm start does not modify the stored solution
+      vector<Teuchos::RCP<LA_MultiVector> > hist_u;
+      vector<ScalarT> hist_t;
+      if (initial_guess != "previous") {
+        u = Teuchos::rcp(new LA_MultiVector(*u, Teuchos::Copy));
+        if (initial_guess == "extrapolate") {
+          vector<size_t> histindex = this->historyIndex(usernum, prev_time, extrap_order);
+          for (size_t k=0; k<histindex.size(); k++) {
+            hist_u.push_back(soln->getData(usernum,histindex[k]));
+            hist_t.push_back(soln->times[usernum][histindex[k]]);
+          }
+          hist_u.push_back(Teuchos::rcp(new LA_MultiVector(*u, Teuchos::Copy)));
+          hist_t.push_back(prev_time);
+        }
+      }
+      
       for (int tstep=0; tstep<time_steps; tstep++) {
         sgtime += macro_deltat/(ScalarT)time_steps;
         // set du/dt and \lambda
@@ -1246,9 +1560,25 @@ void SubGridFEM::subgridSolver(Kokkos::View<ScalarT***,AssemblyDevice> gl_u,
           phi_dot->putScalar(0.0);
         }
         
+        if (initial_guess != "previous") {
+          this->setInitialGuess(u, u_dot, usernum, tstep, current_time, sgtime, alpha, hist_u, hist_t);
+        }
+        
         this->subGridNonlinearSolver(u, u_dot, phi, phi_dot, Psol[0], currlambda,
                                      sgtime, isTransient, isAdjoint, num_active_params, alpha, usernum, false);
         
+        if (initial_guess != "previous") {
+          this->storeIterate(u, usernum, tstep, current_time);
+          if (initial_guess == "extrapolate") {
+            hist_u.push_back(guess_cache[usernum][tstep]);
+            hist_t.push_back(sgtime);
+            if (hist_u.size() > (size_t)extrap_order+1) {
+              hist_u.erase(hist_u.begin());
+              hist_t.erase(hist_t.begin());
+            }
+          }
+        }
+        
         this->computeSubGridSolnSens(d_u, compute_sens, u,
                                      u_dot, phi, phi_dot, Psol[0], currlambda,
                                      sgtime, isTransient, isAdjoint, num_active_params, alpha, lambda_scale, usernum, subgradient);
@@ -1289,6 +1619,102 @@ void SubGridFEM::subgridSolver(Kokkos::View<ScalarT***,AssemblyDevice> gl_u,
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Initial guess for a subgrid time step (u holds the solution at the previous step)
+// Uses the last iterate for this usernum and sub-step if it was computed at the same
+// macro time (previous macro Newton iteration), otherwise extrapolates the history
+// u_dot is set to be consistent with the backward Euler update from the previous step
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::setInitialGuess(Teuchos::RCP<LA_MultiVector> & u, Teuchos::RCP<LA_MultiVector> & u_dot,
+                                 const int & usernum, const int & tstep,
+                                 const ScalarT & current_time, const ScalarT & sgtime, const ScalarT & alpha,
+                                 const vector<Teuchos::RCP<LA_MultiVector> > & hist_u,
+                                 const vector<ScalarT> & hist_t) {
+  
+  Teuchos::RCP<LA_MultiVector> guess;
+  ref_resnorm = 0.0;
+  
+  if (guess_time.size() > (size_t)usernum && abs(guess_time[usernum] - current_time) < 1.0e-12 &&
+      guess_cache[usernum].size() > (size_t)tstep && !guess_cache[usernum][tstep].is_null()) {
+    guess = guess_cache[usernum][tstep];
+    ref_resnorm = guess_refnorm[usernum][tstep];
+  }
+  else if (initial_guess == "extrapolate" && hist_u.size() > 1) {
+    // Lagrange extrapolation through the stored points
+    guess = Teuchos::rcp(new LA_MultiVector(u->getMap(),1));
+    size_t numpts = hist_u.size();
+    for (size_t k=0; k<numpts; k++) {
+      ScalarT wt = 1.0;
+      for (size_t m=0; m<numpts; m++) {
+        if (m != k) {
+          ScalarT dt = hist_t[k] - hist_t[m];
+          if (abs(dt) < 1.0e-14) {
+            return;
+          }
+          wt *= (sgtime - hist_t[m])/dt;
+        }
+      }
+      guess->update(wt, *(hist_u[k]), 1.0);
+    }
+  }
+  
+  if (!guess.is_null()) {
+    u_dot->update(alpha, *guess, -alpha, *u, 0.0);
+    u->assign(*guess);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Keep the converged iterate for a usernum and sub-step (and the residual scale of the
+// first solve at this macro time)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::storeIterate(const Teuchos::RCP<LA_MultiVector> & u, const int & usernum,
+                              const int & tstep, const ScalarT & current_time) {
+  
+  if (guess_time.size() <= (size_t)usernum) {
+    guess_cache.resize(usernum+1);
+    guess_refnorm.resize(usernum+1);
+    guess_time.resize(usernum+1,0.0);
+  }
+  if (guess_cache[usernum].size() == 0 || abs(guess_time[usernum] - current_time) > 1.0e-12) {
+    guess_cache[usernum] = vector<Teuchos::RCP<LA_MultiVector> >(time_steps);
+    guess_refnorm[usernum] = vector<ScalarT>(time_steps,0.0);
+    guess_time[usernum] = current_time;
+  }
+  guess_cache[usernum][tstep] = Teuchos::rcp(new LA_MultiVector(*u, Teuchos::Copy));
+  if (guess_refnorm[usernum][tstep] == 0.0) {
+    guess_refnorm[usernum][tstep] = last_resnorm_initial;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Positions of the (at most num) stored solutions with the latest times before time, in
+// time order.  The stored times are not always increasing (e.g., after a model change or
+// a recomputed step), so the positions are found from the times.
+///////////////////////////////////////////////////////////////////////////////////////
+
+vector<size_t> SubGridFEM::historyIndex(const int & usernum, const ScalarT & time, const size_t & num) {
+  
+  vector<ScalarT> prevtimes;
+  for (size_t k=0; k<soln->getNumTimes(usernum); k++) {
+    if (soln->times[usernum][k] < time - 1.0e-12) {
+      prevtimes.push_back(soln->times[usernum][k]);
+    }
+  }
+  std::sort(prevtimes.begin(), prevtimes.end());
+  
+  vector<size_t> index;
+  for (size_t k=prevtimes.size()-std::min(prevtimes.size(),num); k<prevtimes.size(); k++) {
+    size_t j;
+    if (soln->findTime(usernum, prevtimes[k], j)) {
+      index.push_back(j);
+    }
+  }
+  return index;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Store macro-dofs and flux (for ML-based subgrid)
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -1379,6 +1805,148 @@ void SubGridFEM::sacadoizeParams(const bool & seed_active, const int & num_activ
   
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Check if the cached factorization for a usernum needs to be recomputed
+// (missing, used too many times, different time step, or slow Newton convergence)
+///////////////////////////////////////////////////////////////////////////////////////
+
+bool SubGridFEM::isFactorizationStale(const int & usernum, const ScalarT & alpha, const ScalarT & reduction) {
+  
+  if (factor_age.size() <= (size_t)usernum) {
+    factor_cache.resize(usernum+1);
+    prec_cache.resize(usernum+1);
+    factor_age.resize(usernum+1,0);
+    factor_alpha.resize(usernum+1,0.0);
+    factor_current.resize(usernum+1,false);
+  }
+  
+  bool stale = false;
+  if (useDense) {
+    if (dense_factored.size() <= (size_t)usernum || !dense_factored[usernum]) {
+      stale = true;
+    }
+  }
+  else if (useDirect && factor_cache[usernum].is_null()) {
+    stale = true;
+  }
+  else if (!useDirect && prec_cache[usernum].is_null()) {
+    stale = true;
+  }
+  else if (factor_age[usernum] >= factor_reuse_max) {
+    stale = true;
+  }
+  else if (std::abs(alpha - factor_alpha[usernum]) > 1.0e-12*std::max(1.0,std::abs(alpha))) {
+    stale = true;
+  }
+  else if (reduction > factor_reuse_reduction) {
+    stale = true;
+  }
+  return stale;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Recompute the cached factorization (or preconditioner) for a usernum using the current J
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::updateFactorization(const int & usernum, const ScalarT & alpha) {
+  
+  if (factor_age.size() <= (size_t)usernum) {
+    factor_cache.resize(usernum+1);
+    prec_cache.resize(usernum+1);
+    factor_age.resize(usernum+1,0);
+    factor_alpha.resize(usernum+1,0.0);
+    factor_current.resize(usernum+1,false);
+  }
+  
+  if (useDense) {
+    this->denseFactor(usernum);
+  }
+  else if (useDirect) {
+    if (factor_cache[usernum].is_null()) {
+      factor_cache[usernum] = Amesos2::create<LA_CrsMatrix,LA_MultiVector>("KLU2", J, du_glob, res);
+      factor_cache[usernum]->symbolicFactorization();
+    }
+    else {
+      factor_cache[usernum]->setA(J, Amesos2::SYMBFACT);
+    }
+    factor_cache[usernum]->numericFactorization();
+  }
+  else {
+    prec_cache[usernum] = sub_solver->buildPreconditioner(J);
+  }
+  factor_age[usernum] = 0;
+  factor_alpha[usernum] = alpha;
+  factor_current[usernum] = true;
+  
+  if (LocalComm->getRank() == 0 && subgridverbose>5) {
+    cout << "***** Recomputed the subgrid factorization for usernum " << usernum << endl;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Copy the current J into the dense container and compute its LU factorization
+// Every subgrid problem has the same number of unknowns, so the container is allocated
+// once for all usernums (see allocateDenseFactors)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::denseFactor(const int & usernum) {
+  
+  Teuchos::TimeMonitor localtimer(*sgfemDenseFactorTimer);
+  
+  Teuchos::RCP<const LA_Map> vecmap = res->getMap();
+  Teuchos::RCP<const LA_Map> rowmap = J->getRowMap();
+  Teuchos::RCP<const LA_Map> colmap = J->getColMap();
+  int N = vecmap->getNodeNumElements();
+  
+  // Normally allocated in finalize(), otherwise the container grows geometrically
+  if (dense_LU.extent(0) != (size_t)N || dense_LU.extent(2) <= (size_t)usernum) {
+    this->allocateDenseFactors(std::max((size_t)usernum+1, 2*dense_LU.extent(2)));
+  }
+  
+  auto LU = Kokkos::subview(dense_LU, Kokkos::ALL(), Kokkos::ALL(), usernum);
+  auto piv = Kokkos::subview(dense_piv, Kokkos::ALL(), usernum);
+  Kokkos::deep_copy(LU,0.0);
+  
+  for (size_t lr=0; lr<J->getNodeNumRows(); lr++) {
+    LO row = vecmap->getLocalElement(rowmap->getGlobalElement(lr));
+    Teuchos::ArrayView<const LO> indices;
+    Teuchos::ArrayView<const ScalarT> values;
+    J->getLocalRowView(lr, indices, values);
+    for (size_t j=0; j<(size_t)indices.size(); j++) {
+      LO col = vecmap->getLocalElement(colmap->getGlobalElement(indices[j]));
+      LU(row,col) += values[j];
+    }
+  }
+  
+  int info = 0;
+  lapack.GETRF(N, N, LU.data(), N, piv.data(), &info);
+  TEUCHOS_TEST_FOR_EXCEPTION(info != 0,std::runtime_error,"Error: the dense subgrid LU factorization failed (GETRF info = " + std::to_string(info) + ")");
+  dense_factored[usernum] = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Solve with the stored LU factors of a usernum (all columns of b at once)
+///////////////////////////////////////////////////////////////////////////////////////
+
+void SubGridFEM::denseSolve(const int & usernum, Teuchos::RCP<LA_MultiVector> & x,
+                              const Teuchos::RCP<LA_MultiVector> & b) {
+  
+  Teuchos::TimeMonitor localtimer(*sgfemDenseSolveTimer);
+  
+  x->assign(*b);
+  
+  auto x_kv = x->getLocalView<HostDevice>();
+  auto LU = Kokkos::subview(dense_LU, Kokkos::ALL(), Kokkos::ALL(), usernum);
+  auto piv = Kokkos::subview(dense_piv, Kokkos::ALL(), usernum);
+  int N = LU.extent(0);
+  int nrhs = x_kv.extent(1);
+  int ldx = std::max((int)x_kv.stride(1),1);
+  
+  int info = 0;
+  lapack.GETRS('N', N, nrhs, LU.data(), N, piv.data(), x_kv.data(), ldx, &info);
+  TEUCHOS_TEST_FOR_EXCEPTION(info != 0,std::runtime_error,"Error: the dense subgrid solve failed (GETRS info = " + std::to_string(info) + ")");
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Subgrid Nonlinear Solver
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -1406,6 +1974,10 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
   int iter = 0;
   Kokkos::View<ScalarT**,AssemblyDevice> aPrev;
   
+  // The cached factorizations are for the forward Jacobian
+  bool reuse = factor_reuse && !isAdjoint;
+  ScalarT resnorm_prev = resnorm_scaled[0];
+  
   while (iter < sub_maxNLiter && resnorm_scaled[0] > sub_NLtol) {
     
     sub_J_over->resumeFill();
@@ -1601,6 +2173,11 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
     }
     //KokkosTools::print(J);
     
+    // The cached factorization is no longer from the current J (even if it was just computed)
+    if (factor_current.size() > (size_t)usernum) {
+      factor_current[usernum] = false;
+    }
+    
     
     if (LocalComm->getSize() > 1) {
       res->putScalar(0.0);
@@ -1610,7 +2187,7 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
       res = res_over;
     }
     
-    if (useDirect) {
+    if (useDirect && !reuse && !useDense) {
       if (have_sym_factor) {
         Am2Solver->setA(J, Amesos2::SYMBFACT);
         Am2Solver->setX(du_glob);
@@ -1627,8 +2204,13 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
     
     if (iter == 0) {
       res->normInf(resnorm_initial);
+      last_resnorm_initial = resnorm_initial[0];
+      // A warm start keeps the scale of the residual from the cold start
+      if (ref_resnorm > resnorm_initial[0]) {
+        resnorm_initial[0] = ref_resnorm;
+      }
       if (resnorm_initial[0] > 0.0)
-        resnorm_scaled[0] = 1.0;
+        resnorm_scaled[0] = last_resnorm_initial/resnorm_initial[0];
       else
         resnorm_scaled[0] = 0.0;
     }
@@ -1647,8 +2229,38 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
       
       //Teuchos::TimeMonitor localtimer(*sgfemNonlinearSolverSolveTimer);
       du_glob->putScalar(0.0);
-      if (useDirect) {
-        Am2Solver->numericFactorization().solve();
+      
+      // Refresh the cached factorization if it is stale (including slow convergence)
+      if (reuse) {
+        ScalarT reduction = 0.0;
+        if (iter > 0 && resnorm_prev > 0.0) {
+          reduction = resnorm_scaled[0]/resnorm_prev;
+        }
+        if (this->isFactorizationStale(usernum, alpha, reduction)) {
+          this->updateFactorization(usernum, alpha);
+        }
+        factor_age[usernum]++;
+      }
+      
+      if (useDense) {
+        if (!reuse) {
+          this->denseFactor(usernum);
+        }
+        this->denseSolve(usernum, du_glob, res);
+        // The adjoint factors must not be reused for the forward problem
+        if (isAdjoint && factor_reuse) {
+          dense_factored[usernum] = false;
+        }
+      }
+      else if (useDirect) {
+        if (reuse) {
+          factor_cache[usernum]->setX(du_glob);
+          factor_cache[usernum]->setB(res);
+          factor_cache[usernum]->solve();
+        }
+        else {
+          Am2Solver->numericFactorization().solve();
+        }
       }
       else {
         if (have_belos) {
@@ -1672,8 +2284,13 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
           belos_solver = Teuchos::rcp(new Belos::BlockGmresSolMgr<ScalarT, LA_MultiVector, LA_Operator>(belos_problem, belosList));
           
         }
-        belos_M = sub_solver->buildPreconditioner(J);
-        belos_problem->setRightPrec(belos_M);
+        if (reuse) {
+          belos_problem->setRightPrec(prec_cache[usernum]);
+        }
+        else {
+          belos_M = sub_solver->buildPreconditioner(J);
+          belos_problem->setRightPrec(belos_M);
+        }
         belos_problem->setProblem(du_glob, res);
         {
           Teuchos::TimeMonitor localtimer(*sgfemNonlinearSolverSolveTimer);
@@ -1699,9 +2316,11 @@ void SubGridFEM::subGridNonlinearSolver(Teuchos::RCP<LA_MultiVector> & sub_u,
         sub_u_dot->update(alpha, *du, 1.0);
       }
     }
+    resnorm_prev = resnorm_scaled[0];
     iter++;
     
   }
+  ref_resnorm = 0.0;
   //KokkosTools::print(sub_u);
   
 }
@@ -2010,39 +2629,60 @@ void SubGridFEM::computeSubGridSolnSens(Teuchos::RCP<LA_MultiVector> & d_sub_u,
     }
     //d_sub_res->update(1.0*alpha, *d_sub_u_prev, 1.0);
     
-    if (useDirect) {
+    // All of the derivative columns are solved at once (d_sub_u_over is zero on input)
+    if (useDense) {
       
       Teuchos::TimeMonitor localtimer(*sgfemSolnSensLinearSolverTimer);
       
-      int numsubDerivs = d_sub_u_over->getNumVectors();
+      // The stored factor may be from an earlier iterate or time step (reuse, warm start),
+      // so it is always recomputed from the current J
+      if (factor_reuse && !isAdjoint) {
+        this->updateFactorization(usernum, alpha);
+      }
+      else {
+        this->denseFactor(usernum);
+      }
+      this->denseSolve(usernum, d_sub_u_over, d_sub_res);
+    }
+    else if (useDirect) {
       
-      auto d_sub_u_over_kv = d_sub_u_over->getLocalView<HostDevice>();
-      auto d_sub_res_kv = d_sub_res->getLocalView<HostDevice>();
-      for (int c=0; c<numsubDerivs; c++) {
-        Teuchos::RCP<LA_MultiVector> x = Teuchos::rcp(new LA_MultiVector(overlapped_map,1));
-        Teuchos::RCP<LA_MultiVector> b = Teuchos::rcp(new LA_MultiVector(owned_map,1));
-        auto b_kv = b->getLocalView<HostDevice>();
-        auto x_kv = x->getLocalView<HostDevice>();
-        
-        for (int i=0; i<b->getGlobalLength(); i++) {
-          b_kv(i,0) += d_sub_res_kv(i,c);
-        }
-        Am2Solver->setX(x);
-        Am2Solver->setB(b);
-        Am2Solver->solve();
-        
-        for (int i=0; i<x->getGlobalLength(); i++) {
-          d_sub_u_over_kv(i,c) += x_kv(i,0);
+      Teuchos::TimeMonitor localtimer(*sgfemSolnSensLinearSolverTimer);
+      
+      // KLU2 reuses the factorization from the last Newton iteration for all right-hand sides
+      Teuchos::RCP<Amesos2::Solver<LA_CrsMatrix,LA_MultiVector> > sens_solver = Am2Solver;
+      if (factor_reuse && !isAdjoint) {
+        // The sensitivities need the Jacobian at the converged state, so the factor is
+        // recomputed unless it was computed from the last assembled J
+        if (factor_cache.size() <= (size_t)usernum || factor_cache[usernum].is_null() ||
+            !factor_current[usernum]) {
+          this->updateFactorization(usernum, alpha);
         }
-        
+        sens_solver = factor_cache[usernum];
       }
+      sens_solver->setX(d_sub_u_over);
+      sens_solver->setB(d_sub_res);
+      sens_solver->solve();
     }
     else {
       
       Teuchos::TimeMonitor localtimer(*sgfemSolnSensLinearSolverTimer);
       
+      // Block GMRES on all of the columns (the Newton solves use a block size of one)
+      int numsubDerivs = d_sub_u_over->getNumVectors();
+      belosList->set("Block Size", numsubDerivs);
+      belos_solver->setParameters(belosList);
+      if (factor_reuse && !isAdjoint) {
+        if (prec_cache.size() <= (size_t)usernum || prec_cache[usernum].is_null()) {
+          this->updateFactorization(usernum, alpha);
+        }
+        belos_problem->setRightPrec(prec_cache[usernum]);
+      }
+      
       belos_problem->setProblem(d_sub_u_over, d_sub_res);
       belos_solver->solve();
+      
+      belosList->set("Block Size", 1);
+      belos_solver->setParameters(belosList);
       //sub_solver->linearSolver(J,d_sub_res,d_sub_u_over);
     }
     
@@ -2396,7 +3036,7 @@ void SubGridFEM::writeSolution(const string & filename, const int & usernum) {
     }
     
     vector_RCP u;
-    bool fnd = soln->extract(u,usernum,soln->times[usernum][m],m);
+    bool fnd = soln->extractByIndex(u,m,usernum);
     auto u_kv = u->getLocalView<HostDevice>();
     
     vector<vector<int> > suboffsets = physics_RCP->offsets[0];
@@ -44,6 +44,9 @@
 // Amesos includes
 #include "Amesos2.hpp"
 
+// LAPACK LU for the dense subgrid solver
+#include "Teuchos_LAPACK.hpp"
+
 typedef Belos::LinearProblem<ScalarT, LA_MultiVector, LA_Operator> LA_LinearProblem;
 
 class SubGridFEM : public SubGridModel {
@@ -73,6 +76,45 @@ public:
   
   void finalize();
   
+  ////////////////////////////////////////////////////////////////////////////////
+  // Exchange of the subgrid state with the rank that solves a macro-element
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void packState(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                 vector<ScalarT> & buffer);
+  
+  void unpackState(const int & usernum, const vector<ScalarT> & buffer, size_t & pos);
+  
+  void packResult(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                  vector<ScalarT> & buffer);
+  
+  void unpackResult(const int & usernum, const vector<ScalarT> & buffer, size_t & pos);
+  
+  void packStorage(Teuchos::RCP<SolutionStorage<LA_MultiVector> > & storage, const int & usernum,
+                   const vector<size_t> & timeindex, vector<ScalarT> & buffer);
+  
+  void unpackStorage(Teuchos::RCP<SolutionStorage<LA_MultiVector> > & storage, const int & usernum,
+                     const vector<ScalarT> & buffer, size_t & pos);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Release a macro-element (the usernum goes on free_usernums)
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void removeMacro(const int & usernum);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  // Remove the solutions and iterates computed at a rejected macro time
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void eraseTime(const ScalarT & time);
+  
+  ////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////
+  
+  void packCellData(const int & usernum, vector<ScalarT> & buffer);
+  
+  void unpackCellData(const int & usernum, const vector<ScalarT> & buffer, size_t & pos);
+  
   ////////////////////////////////////////////////////////////////////////////////
   ////////////////////////////////////////////////////////////////////////////////
   
@@ -98,6 +140,40 @@ public:
   
   void sacadoizeParams(const bool & seed_active, const int & num_active_params);
   
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Cached factorizations/preconditioners for each usernum (modified Newton)
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  bool isFactorizationStale(const int & usernum, const ScalarT & alpha, const ScalarT & reduction);
+  
+  void updateFactorization(const int & usernum, const ScalarT & alpha);
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Warm start of the subgrid Newton solves
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void setInitialGuess(Teuchos::RCP<LA_MultiVector> & u, Teuchos::RCP<LA_MultiVector> & u_dot,
+                       const int & usernum, const int & tstep,
+                       const ScalarT & current_time, const ScalarT & sgtime, const ScalarT & alpha,
+                       const vector<Teuchos::RCP<LA_MultiVector> > & hist_u,
+                       const vector<ScalarT> & hist_t);
+  
+  void storeIterate(const Teuchos::RCP<LA_MultiVector> & u, const int & usernum,
+                    const int & tstep, const ScalarT & current_time);
+  
+  vector<size_t> historyIndex(const int & usernum, const ScalarT & time, const size_t & num);
+  
+  ///////////////////////////////////////////////////////////////////////////////////////
+  // Dense LU of the subgrid Jacobians (all usernums share one container)
+  ///////////////////////////////////////////////////////////////////////////////////////
+  
+  void allocateDenseFactors(const size_t & numusers);
+  
+  void denseFactor(const int & usernum);
+  
+  void denseSolve(const int & usernum, Teuchos::RCP<LA_MultiVector> & x,
+                    const Teuchos::RCP<LA_MultiVector> & b);
+  
   ///////////////////////////////////////////////////////////////////////////////////////
   // Subgrid Nonlinear Solver
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -301,6 +377,36 @@ public:
   
   bool have_sym_factor, useDirect;
   
+  // Factorization (or preconditioner) reuse across subgrid Newton iterations, macro iterations
+  // and time steps (one per usernum, refreshed when stale)
+  bool factor_reuse;
+  int factor_reuse_max;
+  ScalarT factor_reuse_reduction;
+  vector<Teuchos::RCP<Amesos2::Solver<LA_CrsMatrix,LA_MultiVector> > > factor_cache;
+  vector<Teuchos::RCP<MueLu::TpetraOperator<ScalarT, LO, GO, HostNode> > > prec_cache;
+  vector<int> factor_age;
+  vector<ScalarT> factor_alpha;
+  vector<bool> factor_current; // false once J is reassembled after the factorization
+  
+  // Dense subgrid solver: the LU factors of every usernum are stored contiguously
+  // (column-major, usernum last) and solved with LAPACK instead of Tpetra/Amesos2
+  bool useDense;
+  int dense_max_size;
+  Kokkos::View<ScalarT***,Kokkos::LayoutLeft,HostDevice> dense_LU;
+  Kokkos::View<int**,Kokkos::LayoutLeft,HostDevice> dense_piv;
+  vector<bool> dense_factored;
+  Teuchos::LAPACK<int,ScalarT> lapack;
+  
+  // Initial guess for the transient subgrid solves: "previous" (solution at the previous step),
+  // "last iterate" (from the previous macro Newton iteration) or "extrapolate" (last iterate
+  // if available, otherwise polynomial extrapolation in time)
+  string initial_guess;
+  int extrap_order;
+  vector<vector<Teuchos::RCP<LA_MultiVector> > > guess_cache; // [usernum][sub-step]
+  vector<vector<ScalarT> > guess_refnorm;
+  vector<ScalarT> guess_time;
+  ScalarT ref_resnorm, last_resnorm_initial;
+  
   vector<string> varlist;
   vector<string> discparamnames;
   Teuchos::RCP<physics> physics_RCP;
@@ -325,6 +431,7 @@ public:
   // Collection of users
   vector<vector<Teuchos::RCP<cell> > > cells;
   vector<vector<Teuchos::RCP<BoundaryCell> > > boundaryCells;
+  vector<int> free_usernums; // released by removeMacro, reused by addMacro
   
   bool have_mesh_data, have_rotations, have_rotation_phi, compute_mesh_data;
   bool have_multiple_data_files;
@@ -335,7 +442,6 @@ public:
   
   // Storage of macro solution and flux (with derivatives)
   //Teuchos::RCP<SolutionStorage<LA_MultiVector> > fluxdata;
-  bool store_aux_and_flux = false;
   vector<Kokkos::View<ScalarT***,AssemblyDevice> > auxdata;
   vector<Kokkos::View<AD***,AssemblyDevice> > fluxdata;
   
@@ -345,6 +451,8 @@ public:
   Teuchos::RCP<Teuchos::Time> sgfemNonlinearSolverTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::subgridNonlinearSolver()");
   Teuchos::RCP<Teuchos::Time> sgfemSolnSensTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::subgridSolnSens()");
   Teuchos::RCP<Teuchos::Time> sgfemSolnSensLinearSolverTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::subgridSolnSens - linear solver");
+  Teuchos::RCP<Teuchos::Time> sgfemDenseFactorTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::denseFactor()");
+  Teuchos::RCP<Teuchos::Time> sgfemDenseSolveTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::denseSolve()");
   Teuchos::RCP<Teuchos::Time> sgfemFluxTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::updateFlux()");
   Teuchos::RCP<Teuchos::Time> sgfemFluxWksetTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::updateFlux - update workset");
   Teuchos::RCP<Teuchos::Time> sgfemFluxCellTimer = Teuchos::TimeMonitor::getNewCounter("MILO::subgridFEM::updateFlux - cell computation");
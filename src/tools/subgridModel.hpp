@@ -34,6 +34,29 @@ public:
   
   virtual void finalize() = 0;
   
+  // Subgrid state read and written by subgridSolver, so that the problem of a macro-element
+  // can be solved on another rank (see MultiScale::computeSubgridSolutions)
+  virtual void packState(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                         vector<ScalarT> & buffer) = 0;
+  
+  virtual void unpackState(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) = 0;
+  
+  virtual void packResult(const int & usernum, const ScalarT & time, const bool & compute_sens,
+                          vector<ScalarT> & buffer) = 0;
+  
+  virtual void unpackResult(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) = 0;
+  
+  // Release a macro-element (its usernum is reused by the next addMacro)
+  virtual void removeMacro(const int & usernum) = 0;
+  
+  // Remove the states stored at a macro time (used when a macro time step is rejected)
+  virtual void eraseTime(const ScalarT & time) = 0;
+  
+  // Mesh data of a macro-element (for copies added after addMeshData)
+  virtual void packCellData(const int & usernum, vector<ScalarT> & buffer) = 0;
+  
+  virtual void unpackCellData(const int & usernum, const vector<ScalarT> & buffer, size_t & pos) = 0;
+  
   virtual void subgridSolver(Kokkos::View<ScalarT***,AssemblyDevice> gl_u,
                              Kokkos::View<ScalarT***,AssemblyDevice> gl_phi,
                              const ScalarT & time, const bool & isTransient, const bool & isAdjoint,
@@ -98,6 +121,7 @@ public:
   vector<string> macro_paramnames, macro_disc_paramnames;
   int macro_block;
   ScalarT cost_estimate;
+  bool store_aux_and_flux = false;
   
   //bvbw  Teuchos::RCP<const LA_Map> owned_map, overlapped_map;
   Teuchos::RCP<const Tpetra::Map<LO, GO, HostNode> > owned_map, overlapped_map;
@@ -26,19 +26,21 @@ public:
   
   TimeIntegrator() {} ;
   
-  ~TimeIntegrator() {};
+  virtual ~TimeIntegrator() {};
   
   ///////////////////////////////////////////////////////////////////////////////////////
   // Combine the stage solution to compute the end-node solution
   ///////////////////////////////////////////////////////////////////////////////////////
   
-  virtual void computeSolution(vector_RCP & stage_sol, vector_RCP & sol);
+  virtual void computeSolution(vector_RCP & stage_sol, vector_RCP & sol) {};
   
   ///////////////////////////////////////////////////////////////////////////////////////
   // Compute the stage time
   ///////////////////////////////////////////////////////////////////////////////////////
   
-  virtual ScalarT computeTime(const ScalarT & prevtime, const size_t snum, const ScalarT & deltat);
+  virtual ScalarT computeTime(const ScalarT & prevtime, const size_t snum, const ScalarT & deltat) {
+    return prevtime + deltat;
+  };
   
   ///////////////////////////////////////////////////////////////////////////////////////
   // Public data
@@ -31,6 +31,7 @@ celltopo(topo), var_bcs(var_bcs_)  { //, timeInt(timeInt_) {
   numDOF = cellinfo[4];
   numElem = cellinfo[5];
   usebcs = true;
+  use_sum_factorization = false;
   
   /*
    num_stages = 1;//timeInt->num_stages;
@@ -452,6 +453,120 @@ void workset::update(const DRV & ip_, const DRV & jacobian, const vector<vector<
   
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// Update the nodes and use previously computed basis functions at the volumetric ip
+////////////////////////////////////////////////////////////////////////////////////
+
+void workset::update(const DRV & ip_, const VolumeGeometry & geom) {
+  
+  {
+    Teuchos::TimeMonitor updatetimer(*worksetUpdateIPTimer);
+    ip = ip_;
+    
+    parallel_for(RangePolicy<AssemblyDevice>(0,ip.extent(0)), KOKKOS_LAMBDA (const int e ) {
+      for (size_t j=0; j<numip; j++) {
+        for (size_t k=0; k<dimension; k++) {
+          ip_KV(e,j,k) = ip(e,j,k);
+        }
+      }
+    });
+  }
+  
+  wts = geom.wts;
+  jacobDet = geom.jacobDet;
+  jacobInv = geom.jacobInv;
+  h = geom.h;
+  basis = geom.basis;
+  basis_uw = geom.basis_uw;
+  basis_grad = geom.basis_grad;
+  basis_grad_uw = geom.basis_grad_uw;
+  basis_div = geom.basis_div;
+  basis_div_uw = geom.basis_div_uw;
+  basis_curl = geom.basis_curl;
+  basis_curl_uw = geom.basis_curl_uw;
+  param_basis_grad = geom.param_basis_grad;
+  
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Get the current volumetric geometry (shallow copies)
+////////////////////////////////////////////////////////////////////////////////////
+
+VolumeGeometry workset::getVolumeGeometry() {
+  
+  VolumeGeometry geom;
+  geom.wts = wts;
+  geom.jacobDet = jacobDet;
+  geom.jacobInv = jacobInv;
+  geom.h = h;
+  geom.basis = basis;
+  geom.basis_uw = basis_uw;
+  geom.basis_grad = basis_grad;
+  geom.basis_grad_uw = basis_grad_uw;
+  geom.basis_div = basis_div;
+  geom.basis_div_uw = basis_div_uw;
+  geom.basis_curl = basis_curl;
+  geom.basis_curl_uw = basis_curl_uw;
+  geom.param_basis_grad = param_basis_grad;
+  return geom;
+  
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Allocate new storage with the same layout as the current volumetric geometry
+////////////////////////////////////////////////////////////////////////////////////
+
+static DRV allocateLike(const DRV & x, const string & label) {
+  DRV y;
+  if (x.size() > 0) {
+    switch (x.rank()) {
+      case 1 :
+        y = DRV(label, x.extent(0));
+        break;
+      case 2 :
+        y = DRV(label, x.extent(0), x.extent(1));
+        break;
+      case 3 :
+        y = DRV(label, x.extent(0), x.extent(1), x.extent(2));
+        break;
+      case 4 :
+        y = DRV(label, x.extent(0), x.extent(1), x.extent(2), x.extent(3));
+        break;
+      default :
+        TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Workset Error: unsupported rank when allocating " + label);
+    }
+  }
+  return y;
+}
+
+static vector<DRV> allocateLike(const vector<DRV> & x, const string & label) {
+  vector<DRV> y;
+  for (size_t i=0; i<x.size(); i++) {
+    y.push_back(allocateLike(x[i], label));
+  }
+  return y;
+}
+
+VolumeGeometry workset::allocateVolumeGeometry() {
+  
+  VolumeGeometry geom;
+  geom.wts = allocateLike(wts, "wts");
+  geom.jacobDet = allocateLike(jacobDet, "jacobDet");
+  geom.jacobInv = allocateLike(jacobInv, "jacobInv");
+  geom.h = Kokkos::View<ScalarT*,AssemblyDevice>("h",h.extent(0));
+  geom.basis = allocateLike(basis, "basis");
+  geom.basis_uw = allocateLike(basis_uw, "basis_uw");
+  geom.basis_grad = allocateLike(basis_grad, "basis_grad");
+  geom.basis_grad_uw = allocateLike(basis_grad_uw, "basis_grad_uw");
+  geom.basis_div = allocateLike(basis_div, "basis_div");
+  geom.basis_div_uw = allocateLike(basis_div_uw, "basis_div_uw");
+  geom.basis_curl = allocateLike(basis_curl, "basis_curl");
+  geom.basis_curl_uw = allocateLike(basis_curl_uw, "basis_curl_uw");
+  geom.param_basis_grad = allocateLike(param_basis_grad, "param_basis_grad");
+  return geom;
+  
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // Update the nodes and the basis functions at the side ip
 ////////////////////////////////////////////////////////////////////////////////////
@@ -859,7 +974,15 @@ void workset::computeSolnVolIP(Kokkos::View<ScalarT***,AssemblyDevice> u) {
       int knbasis = numbasis[kubasis];
       string kutype = basis_types[kubasis];
       
-      if (kutype == "HGRAD") {
+      if (kutype == "HGRAD" && use_sum_factorization && tensor_basis[kubasis]) {
+        for (int e=0; e<numElem; e++) {
+          for( int i=0; i<knbasis; i++ ) {
+            tensor_coeff(i) = u(e,k,i);
+          }
+          this->interpolateTensor(kubasis, e, k, true, local_soln, local_soln_grad);
+        }
+      }
+      else if (kutype == "HGRAD") {
         DRV kbasis_uw = basis_uw[kubasis];
         DRV kbasis_grad_uw = basis_grad_uw[kubasis];
         
@@ -947,7 +1070,29 @@ void workset::computeSolnVolIP(Kokkos::View<ScalarT***,AssemblyDevice> u,
       int knbasis = numbasis[kubasis];
       string kutype = basis_types[kubasis];
       
-      if (kutype == "HGRAD") {
+      if (kutype == "HGRAD" && use_sum_factorization && tensor_basis[kubasis]) {
+        for (int e=0; e<numElem; e++) {
+          for( int i=0; i<knbasis; i++ ) {
+            if (seedu) {
+              tensor_coeff(i) = AD(maxDerivs,offsets(k,i),u(e,k,i));
+            }
+            else {
+              tensor_coeff(i) = u(e,k,i);
+            }
+          }
+          this->interpolateTensor(kubasis, e, k, true, local_soln, local_soln_grad);
+          for( int i=0; i<knbasis; i++ ) {
+            if (seedudot) {
+              tensor_coeff(i) = AD(maxDerivs,offsets(k,i),u_dot(e,k,i));
+            }
+            else {
+              tensor_coeff(i) = u_dot(e,k,i);
+            }
+          }
+          this->interpolateTensor(kubasis, e, k, false, local_soln_dot, local_soln_dot_grad);
+        }
+      }
+      else if (kutype == "HGRAD") {
         DRV kbasis_uw = basis_uw[kubasis];
         DRV kbasis_grad_uw = basis_grad_uw[kubasis];
         
@@ -1041,6 +1186,503 @@ void workset::computeSolnVolIP(Kokkos::View<ScalarT***,AssemblyDevice> u,
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// Compute the solutions at the volumetric ip using pre-seeded AD coefficients
+////////////////////////////////////////////////////////////////////////////////////
+
+void workset::computeSolnVolIP(Kokkos::View<AD***,AssemblyDevice> u_AD,
+                               Kokkos::View<AD***,AssemblyDevice> u_dot_AD) {
+  
+  {
+    Teuchos::TimeMonitor resettimer(*worksetResetTimer);
+    parallel_for(RangePolicy<AssemblyDevice>(0,local_soln.extent(0)), KOKKOS_LAMBDA (const int e ) {
+      for (int k=0; k<local_soln.extent(1); k++) {
+        for (int i=0; i<local_soln.extent(2); i++) {
+          for (int s=0; s<local_soln.extent(3); s++) {
+            local_soln(e,k,i,s) = 0.0;
+            local_soln_dot(e,k,i,s) = 0.0;
+            local_soln_grad(e,k,i,s) = 0.0;
+            local_soln_curl(e,k,i,s) = 0.0;
+          }
+          local_soln_div(e,k,i) = 0.0;
+        }
+      }
+    });
+  }
+  
+  {
+    Teuchos::TimeMonitor basistimer(*worksetComputeSolnVolTimer);
+    AD uval, u_dotval;
+    
+    for (int k=0; k<numVars; k++) {
+      int kubasis = usebasis[k];
+      int knbasis = numbasis[kubasis];
+      string kutype = basis_types[kubasis];
+      
+      if (kutype == "HGRAD" && use_sum_factorization && tensor_basis[kubasis]) {
+        for (int e=0; e<numElem; e++) {
+          for( int i=0; i<knbasis; i++ ) {
+            tensor_coeff(i) = u_AD(e,k,i);
+          }
+          this->interpolateTensor(kubasis, e, k, true, local_soln, local_soln_grad);
+          for( int i=0; i<knbasis; i++ ) {
+            tensor_coeff(i) = u_dot_AD(e,k,i);
+          }
+          this->interpolateTensor(kubasis, e, k, false, local_soln_dot, local_soln_dot_grad);
+        }
+      }
+      else if (kutype == "HGRAD") {
+        DRV kbasis_uw = basis_uw[kubasis];
+        DRV kbasis_grad_uw = basis_grad_uw[kubasis];
+        
+        for( int i=0; i<knbasis; i++ ) {
+          for (int e=0; e<numElem; e++) {
+            uval = u_AD(e,k,i);
+            u_dotval = u_dot_AD(e,k,i);
+            for( size_t j=0; j<numip; j++ ) {
+              local_soln(e,k,j,0) += uval*kbasis_uw(e,i,j);
+              local_soln_dot(e,k,j,0) += u_dotval*kbasis_uw(e,i,j);
+              for( int s=0; s<dimension; s++ ) {
+                local_soln_grad(e,k,j,s) += uval*kbasis_grad_uw(e,i,j,s);
+              }
+            }
+          }
+        }
+      }
+      else if (kutype == "HDIV"){
+        DRV kbasis_uw = basis_uw[kubasis];
+        DRV kbasis_div_uw = basis_div_uw[kubasis];
+        
+        for( int i=0; i<knbasis; i++ ) {
+          for (int e=0; e<numElem; e++) {
+            uval = u_AD(e,k,i);
+            u_dotval = u_dot_AD(e,k,i);
+            for( size_t j=0; j<numip; j++ ) {
+              for( int s=0; s<dimension; s++ ) {
+                local_soln(e,k,j,s) += uval*kbasis_uw(e,i,j,s);
+                local_soln_dot(e,k,j,s) += u_dotval*kbasis_uw(e,i,j,s);
+              }
+              local_soln_div(e,k,j) += uval*kbasis_div_uw(e,i,j);
+            }
+          }
+        }
+      }
+      else if (kutype == "HCURL"){
+        DRV kbasis_uw = basis_uw[kubasis];
+        DRV kbasis_curl_uw = basis_curl_uw[kubasis];
+        
+        for( int i=0; i<knbasis; i++ ) {
+          for (int e=0; e<numElem; e++) {
+            uval = u_AD(e,k,i);
+            u_dotval = u_dot_AD(e,k,i);
+            for( size_t j=0; j<numip; j++ ) {
+              for( int s=0; s<dimension; s++ ) {
+                local_soln(e,k,j,s) += uval*kbasis_uw(e,i,j,s);
+                local_soln_dot(e,k,j,s) += u_dotval*kbasis_uw(e,i,j,s);
+                local_soln_curl(e,k,j,s) += uval*kbasis_curl_uw(e,i,j,s);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Set up the 1D tables needed for sum factorization
+// A basis is only flagged as a tensor basis if the tensor products of the 1D tables
+// reproduce the reference basis values and gradients at the volumetric ip
+////////////////////////////////////////////////////////////////////////////////////
+
+void workset::setupTensorBasis() {
+  
+  use_sum_factorization = false;
+  tensor_basis = vector<bool>(basis_pointers.size(),false);
+  tensor_nb = vector<int>(basis_pointers.size(),0);
+  tensor_nq = vector<int>(basis_pointers.size(),0);
+  tensor_val = vector<Kokkos::View<ScalarT**,AssemblyDevice> >(basis_pointers.size());
+  tensor_grad = vector<Kokkos::View<ScalarT**,AssemblyDevice> >(basis_pointers.size());
+  tensor_dof = vector<Kokkos::View<int*,AssemblyDevice> >(basis_pointers.size());
+  tensor_ip = vector<Kokkos::View<int*,AssemblyDevice> >(basis_pointers.size());
+  
+  bool is_tensor_cell = (dimension == 2 && celltopo->getBaseKey() == shards::Quadrilateral<>::key) ||
+                        (dimension == 3 && celltopo->getBaseKey() == shards::Hexahedron<>::key);
+  if (!is_tensor_cell) {
+    return;
+  }
+  
+  ScalarT tol = 1.0e-12;
+  
+  // 1D integration points (the volumetric cubature must be a tensor product)
+  vector<ScalarT> pts1d;
+  for (size_t j=0; j<numip; j++) {
+    pts1d.push_back(ref_ip(j,0));
+  }
+  std::sort(pts1d.begin(), pts1d.end());
+  vector<ScalarT> upts1d;
+  for (size_t j=0; j<pts1d.size(); j++) {
+    if (upts1d.size() == 0 || std::abs(pts1d[j] - upts1d.back()) > tol) {
+      upts1d.push_back(pts1d[j]);
+    }
+  }
+  int nq = upts1d.size();
+  int nqtot = (dimension == 2) ? nq*nq : nq*nq*nq;
+  if (nqtot != (int)numip) {
+    return;
+  }
+  
+  Kokkos::View<int*,AssemblyDevice> ipmap("ip lattice map",numip);
+  Kokkos::deep_copy(ipmap,-1);
+  for (size_t j=0; j<numip; j++) {
+    int lindex = 0, stride = 1;
+    for (int d=0; d<dimension; d++) {
+      int ind = -1;
+      for (int q=0; q<nq; q++) {
+        if (std::abs(ref_ip(j,d) - upts1d[q]) < tol) {
+          ind = q;
+        }
+      }
+      if (ind < 0) {
+        return;
+      }
+      lindex += ind*stride;
+      stride *= nq;
+    }
+    if (ipmap(lindex) >= 0) {
+      return;
+    }
+    ipmap(lindex) = j;
+  }
+  
+  DRV ref_ip1d("1D integration points",nq,1);
+  for (int q=0; q<nq; q++) {
+    ref_ip1d(q,0) = upts1d[q];
+  }
+  
+  size_t maxcoeff = 0, maxx = 0, maxxy = 0;
+  
+  for (size_t b=0; b<basis_pointers.size(); b++) {
+    if (basis_types[b] != "HGRAD") {
+      continue;
+    }
+    int degree = basis_pointers[b]->getDegree();
+    if (degree < 2) { // nothing to gain for linear elements
+      continue;
+    }
+    
+    Intrepid2::Basis_HGRAD_LINE_Cn_FEM<AssemblyDevice> line_basis(degree,POINTTYPE_EQUISPACED);
+    int nb = line_basis.getCardinality();
+    int nbtot = (dimension == 2) ? nb*nb : nb*nb*nb;
+    if (nbtot != numbasis[b]) {
+      continue;
+    }
+    
+    // Match the dof coordinates to the 1D nodes to get the lattice ordering of the basis
+    DRV line_coords("line dof coords",nb,1);
+    line_basis.getDofCoords(line_coords);
+    DRV dof_coords("dof coords",numbasis[b],dimension);
+    basis_pointers[b]->getDofCoords(dof_coords);
+    
+    Kokkos::View<int*,AssemblyDevice> dofmap("dof lattice map",nbtot);
+    Kokkos::deep_copy(dofmap,-1);
+    bool isvalid = true;
+    for (int i=0; i<numbasis[b]; i++) {
+      int lindex = 0, stride = 1;
+      for (int d=0; d<dimension; d++) {
+        int ind = -1;
+        for (int n=0; n<nb; n++) {
+          if (std::abs(dof_coords(i,d) - line_coords(n,0)) < tol) {
+            ind = n;
+          }
+        }
+        if (ind < 0) {
+          isvalid = false;
+        }
+        lindex += ind*stride;
+        stride *= nb;
+      }
+      if (isvalid && dofmap(lindex) < 0) {
+        dofmap(lindex) = i;
+      }
+      else {
+        isvalid = false;
+      }
+    }
+    if (!isvalid) {
+      continue;
+    }
+    
+    DRV lvals("line basis values",nb,nq);
+    line_basis.getValues(lvals, ref_ip1d, OPERATOR_VALUE);
+    DRV lgrads("line basis grads",nb,nq,1);
+    line_basis.getValues(lgrads, ref_ip1d, OPERATOR_GRAD);
+    
+    Kokkos::View<ScalarT**,AssemblyDevice> vals1d("1D basis values",nq,nb);
+    Kokkos::View<ScalarT**,AssemblyDevice> grads1d("1D basis grads",nq,nb);
+    for (int q=0; q<nq; q++) {
+      for (int n=0; n<nb; n++) {
+        vals1d(q,n) = lvals(n,q);
+        grads1d(q,n) = lgrads(n,q,0);
+      }
+    }
+    
+    // Check the tensor products against the reference basis
+    int nbz = (dimension == 2) ? 1 : nb;
+    int nqz = (dimension == 2) ? 1 : nq;
+    for (int iz=0; iz<nbz; iz++) {
+      for (int iy=0; iy<nb; iy++) {
+        for (int ix=0; ix<nb; ix++) {
+          int i = dofmap(ix + nb*(iy + nb*iz));
+          for (int qz=0; qz<nqz; qz++) {
+            for (int qy=0; qy<nq; qy++) {
+              for (int qx=0; qx<nq; qx++) {
+                int j = ipmap(qx + nq*(qy + nq*qz));
+                ScalarT vz = (dimension == 2) ? 1.0 : vals1d(qz,iz);
+                ScalarT val = vals1d(qx,ix)*vals1d(qy,iy)*vz;
+                ScalarT dx = grads1d(qx,ix)*vals1d(qy,iy)*vz;
+                ScalarT dy = vals1d(qx,ix)*grads1d(qy,iy)*vz;
+                if (std::abs(val - ref_basis[b](0,i,j)) > 1.0e-10 ||
+                    std::abs(dx - ref_basis_grad[b](i,j,0)) > 1.0e-10 ||
+                    std::abs(dy - ref_basis_grad[b](i,j,1)) > 1.0e-10) {
+                  isvalid = false;
+                }
+                if (dimension == 3) {
+                  ScalarT dz = vals1d(qx,ix)*vals1d(qy,iy)*grads1d(qz,iz);
+                  if (std::abs(dz - ref_basis_grad[b](i,j,2)) > 1.0e-10) {
+                    isvalid = false;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    if (!isvalid) {
+      continue;
+    }
+    
+    tensor_basis[b] = true;
+    tensor_nb[b] = nb;
+    tensor_nq[b] = nq;
+    tensor_val[b] = vals1d;
+    tensor_grad[b] = grads1d;
+    tensor_dof[b] = dofmap;
+    tensor_ip[b] = ipmap;
+    use_sum_factorization = true;
+    
+    maxcoeff = std::max(maxcoeff,(size_t)nbtot);
+    maxx = std::max(maxx,(size_t)(nq*nb*nbz));
+    maxxy = std::max(maxxy,(size_t)(nq*nq*nbz));
+  }
+  
+  if (use_sum_factorization) {
+    tensor_coeff = Kokkos::View<AD*,AssemblyDevice>("tensor coefficients",maxcoeff);
+    tensor_x0 = Kokkos::View<AD*,AssemblyDevice>("tensor x0",maxx);
+    tensor_x1 = Kokkos::View<AD*,AssemblyDevice>("tensor x1",maxx);
+    tensor_xy00 = Kokkos::View<AD*,AssemblyDevice>("tensor xy00",maxxy);
+    tensor_xy10 = Kokkos::View<AD*,AssemblyDevice>("tensor xy10",maxxy);
+    tensor_xy01 = Kokkos::View<AD*,AssemblyDevice>("tensor xy01",maxxy);
+    tensor_ipvals = Kokkos::View<AD**,AssemblyDevice>("tensor ip values",numip,dimension+1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Interpolate the coefficients in tensor_coeff (ordered like the basis) to the
+// volumetric ip of element e using sum factorization
+////////////////////////////////////////////////////////////////////////////////////
+
+void workset::interpolateTensor(const int & b, const int & e, const int & k, const bool & compute_grad,
+                                Kokkos::View<AD****,AssemblyDevice> vals,
+                                Kokkos::View<AD****,AssemblyDevice> grads) {
+  
+  int nb = tensor_nb[b], nq = tensor_nq[b];
+  int nbz = (dimension == 2) ? 1 : nb;
+  Kokkos::View<ScalarT**,AssemblyDevice> V = tensor_val[b], G = tensor_grad[b];
+  Kokkos::View<int*,AssemblyDevice> dofmap = tensor_dof[b], ipmap = tensor_ip[b];
+  
+  // Contract over x
+  for (int iz=0; iz<nbz; iz++) {
+    for (int iy=0; iy<nb; iy++) {
+      for (int qx=0; qx<nq; qx++) {
+        AD v0 = 0.0, v1 = 0.0;
+        for (int ix=0; ix<nb; ix++) {
+          AD c = tensor_coeff(dofmap(ix + nb*(iy + nb*iz)));
+          v0 += V(qx,ix)*c;
+          if (compute_grad) {
+            v1 += G(qx,ix)*c;
+          }
+        }
+        tensor_x0(qx + nq*(iy + nb*iz)) = v0;
+        tensor_x1(qx + nq*(iy + nb*iz)) = v1;
+      }
+    }
+  }
+  
+  // Contract over y
+  for (int iz=0; iz<nbz; iz++) {
+    for (int qy=0; qy<nq; qy++) {
+      for (int qx=0; qx<nq; qx++) {
+        AD v00 = 0.0, v10 = 0.0, v01 = 0.0;
+        for (int iy=0; iy<nb; iy++) {
+          int xind = qx + nq*(iy + nb*iz);
+          v00 += V(qy,iy)*tensor_x0(xind);
+          if (compute_grad) {
+            v10 += V(qy,iy)*tensor_x1(xind);
+            v01 += G(qy,iy)*tensor_x0(xind);
+          }
+        }
+        int xyind = qx + nq*(qy + nq*iz);
+        tensor_xy00(xyind) = v00;
+        tensor_xy10(xyind) = v10;
+        tensor_xy01(xyind) = v01;
+      }
+    }
+  }
+  
+  // Contract over z (3D) and store the values and reference gradients at the ip
+  if (dimension == 2) {
+    for (int qy=0; qy<nq; qy++) {
+      for (int qx=0; qx<nq; qx++) {
+        int xyind = qx + nq*qy;
+        int j = ipmap(xyind);
+        tensor_ipvals(j,0) = tensor_xy00(xyind);
+        tensor_ipvals(j,1) = tensor_xy10(xyind);
+        tensor_ipvals(j,2) = tensor_xy01(xyind);
+      }
+    }
+  }
+  else {
+    for (int qz=0; qz<nq; qz++) {
+      for (int qy=0; qy<nq; qy++) {
+        for (int qx=0; qx<nq; qx++) {
+          AD v = 0.0, dx = 0.0, dy = 0.0, dz = 0.0;
+          for (int iz=0; iz<nb; iz++) {
+            int xyind = qx + nq*(qy + nq*iz);
+            v += V(qz,iz)*tensor_xy00(xyind);
+            if (compute_grad) {
+              dx += V(qz,iz)*tensor_xy10(xyind);
+              dy += V(qz,iz)*tensor_xy01(xyind);
+              dz += G(qz,iz)*tensor_xy00(xyind);
+            }
+          }
+          int j = ipmap(qx + nq*(qy + nq*qz));
+          tensor_ipvals(j,0) = v;
+          tensor_ipvals(j,1) = dx;
+          tensor_ipvals(j,2) = dy;
+          tensor_ipvals(j,3) = dz;
+        }
+      }
+    }
+  }
+  
+  for (size_t j=0; j<numip; j++) {
+    vals(e,k,j,0) = tensor_ipvals(j,0);
+    if (compute_grad) {
+      // physical gradient: grad_s = sum_r jacobInv(r,s)*d/dx_r (same as HGRADtransformGRAD)
+      for (int s=0; s<dimension; s++) {
+        AD g = 0.0;
+        for (int r=0; r<dimension; r++) {
+          g += jacobInv(e,j,r,s)*tensor_ipvals(j,r+1);
+        }
+        grads(e,k,j,s) = g;
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Add int(f*v + flux.grad(v)) to the residual of variable k using sum factorization
+// This is the transpose of interpolateTensor
+////////////////////////////////////////////////////////////////////////////////////
+
+void workset::integrateTensor(const int & b, const int & k, Kokkos::View<AD**,AssemblyDevice> f,
+                              Kokkos::View<AD***,AssemblyDevice> flux) {
+  
+  Teuchos::TimeMonitor inttimer(*worksetIntegrateTensorTimer);
+  
+  int nb = tensor_nb[b], nq = tensor_nq[b];
+  int nbz = (dimension == 2) ? 1 : nb;
+  Kokkos::View<ScalarT**,AssemblyDevice> V = tensor_val[b], G = tensor_grad[b];
+  Kokkos::View<int*,AssemblyDevice> dofmap = tensor_dof[b], ipmap = tensor_ip[b];
+  
+  for (size_t e=0; e<f.extent(0); e++) {
+    
+    // Weighted source and flux mapped back to the reference element (lattice ordering)
+    for (size_t l=0; l<numip; l++) {
+      int j = ipmap(l);
+      tensor_ipvals(l,0) = wts(e,j)*f(e,j);
+      for (int r=0; r<dimension; r++) {
+        AD g = 0.0;
+        for (int s=0; s<dimension; s++) {
+          g += jacobInv(e,j,r,s)*flux(e,j,s);
+        }
+        tensor_ipvals(l,r+1) = wts(e,j)*g;
+      }
+    }
+    
+    // Contract over z (3D)
+    if (dimension == 2) {
+      for (size_t l=0; l<numip; l++) {
+        tensor_xy00(l) = tensor_ipvals(l,0);
+        tensor_xy10(l) = tensor_ipvals(l,1);
+        tensor_xy01(l) = tensor_ipvals(l,2);
+      }
+    }
+    else {
+      for (int iz=0; iz<nb; iz++) {
+        for (int qy=0; qy<nq; qy++) {
+          for (int qx=0; qx<nq; qx++) {
+            AD v00 = 0.0, v10 = 0.0, v01 = 0.0;
+            for (int qz=0; qz<nq; qz++) {
+              int l = qx + nq*(qy + nq*qz);
+              v00 += V(qz,iz)*tensor_ipvals(l,0) + G(qz,iz)*tensor_ipvals(l,3);
+              v10 += V(qz,iz)*tensor_ipvals(l,1);
+              v01 += V(qz,iz)*tensor_ipvals(l,2);
+            }
+            int xyind = qx + nq*(qy + nq*iz);
+            tensor_xy00(xyind) = v00;
+            tensor_xy10(xyind) = v10;
+            tensor_xy01(xyind) = v01;
+          }
+        }
+      }
+    }
+    
+    // Contract over y
+    for (int iz=0; iz<nbz; iz++) {
+      for (int iy=0; iy<nb; iy++) {
+        for (int qx=0; qx<nq; qx++) {
+          AD v0 = 0.0, v1 = 0.0;
+          for (int qy=0; qy<nq; qy++) {
+            int xyind = qx + nq*(qy + nq*iz);
+            v0 += V(qy,iy)*tensor_xy00(xyind) + G(qy,iy)*tensor_xy01(xyind);
+            v1 += V(qy,iy)*tensor_xy10(xyind);
+          }
+          tensor_x0(qx + nq*(iy + nb*iz)) = v0;
+          tensor_x1(qx + nq*(iy + nb*iz)) = v1;
+        }
+      }
+    }
+    
+    // Contract over x and add to the residual
+    for (int iz=0; iz<nbz; iz++) {
+      for (int iy=0; iy<nb; iy++) {
+        for (int ix=0; ix<nb; ix++) {
+          AD v = 0.0;
+          for (int qx=0; qx<nq; qx++) {
+            int xind = qx + nq*(iy + nb*iz);
+            v += V(qx,ix)*tensor_x0(xind) + G(qx,ix)*tensor_x1(xind);
+          }
+          int i = dofmap(ix + nb*(iy + nb*iz));
+          res(e,offsets(k,i)) += v;
+        }
+      }
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // Compute the discretized parameters at the volumetric ip
 ////////////////////////////////////////////////////////////////////////////////////
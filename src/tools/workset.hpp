@@ -16,6 +16,16 @@
 #include "preferences.hpp"
 #include "discretizationTools.hpp"
 
+// Geometric data and transformed basis functions at the volumetric ip for one set of elements
+// (a cell may keep one of these to avoid recomputing them, see cell::updateWorksetBasis)
+// The side data of the boundary cells is already stored in the workset by addSide
+struct VolumeGeometry {
+  DRV wts, jacobDet, jacobInv;
+  Kokkos::View<ScalarT*,AssemblyDevice> h;
+  vector<DRV> basis, basis_uw, basis_grad, basis_grad_uw, basis_div, basis_div_uw;
+  vector<DRV> basis_curl, basis_curl_uw, param_basis_grad;
+};
+
 class workset {
   public:
   
@@ -47,6 +57,20 @@ class workset {
   
   void update(const DRV & ip_, const DRV & jacobian, const vector<vector<ScalarT> > & orientation);
   
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Update the nodes and use previously computed basis functions at the volumetric ip
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  void update(const DRV & ip_, const VolumeGeometry & geom);
+  
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Get the current volumetric geometry, or new storage with the same layout
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  VolumeGeometry getVolumeGeometry();
+  
+  VolumeGeometry allocateVolumeGeometry();
+  
   ////////////////////////////////////////////////////////////////////////////////////
   // Add a side information
   ////////////////////////////////////////////////////////////////////////////////////
@@ -61,7 +85,8 @@ class workset {
                   const DRV & normals_, const DRV & sidejacobian, const int & s);
   
   ////////////////////////////////////////////////////////////////////////////////////
-  // Update the nodes and the basis functions at the side ip
+  // Use the side ip, normals and basis functions stored by addSide for boundary cell cnum
+  // (the side data is always computed once at setup, so there is no side VolumeGeometry)
   ////////////////////////////////////////////////////////////////////////////////////
   
   void updateSide(const int & sidenum, const int & cnum);
@@ -116,6 +141,35 @@ class workset {
                         Kokkos::View<ScalarT***,AssemblyDevice> u_dot,
                         const bool & seedu, const bool & seedudot);
 
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Compute the solutions at the volumetric ip using pre-seeded AD coefficients
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  void computeSolnVolIP(Kokkos::View<AD***,AssemblyDevice> u_AD,
+                        Kokkos::View<AD***,AssemblyDevice> u_dot_AD);
+  
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Sum factorization for the tensor-product HGRAD bases on quads and hexes
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  void setupTensorBasis();
+  
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Interpolate the coefficients in tensor_coeff to the volumetric ip of element e
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  void interpolateTensor(const int & b, const int & e, const int & k, const bool & compute_grad,
+                         Kokkos::View<AD****,AssemblyDevice> vals,
+                         Kokkos::View<AD****,AssemblyDevice> grads);
+  
+  ////////////////////////////////////////////////////////////////////////////////////
+  // Add int(f*v + flux.grad(v)) to the residual of variable k for each element
+  // f and flux are given at the volumetric ip and are not weighted
+  ////////////////////////////////////////////////////////////////////////////////////
+  
+  void integrateTensor(const int & b, const int & k, Kokkos::View<AD**,AssemblyDevice> f,
+                       Kokkos::View<AD***,AssemblyDevice> flux);
+  
   ////////////////////////////////////////////////////////////////////////////////////
   // Compute the discretized parameters at the volumetric ip
   ////////////////////////////////////////////////////////////////////////////////////
@@ -245,6 +299,17 @@ class workset {
   Kokkos::View<ScalarT***,AssemblyDevice> rotation;
   Kokkos::View<ScalarT**,AssemblyDevice> rotation_phi;
   
+  // Sum factorization data (see setupTensorBasis)
+  // The 1D tables are indexed by (1D ip, 1D basis) and the lattice maps give the
+  // basis/ip index for lattice index ix + n*(iy + n*iz)
+  bool use_sum_factorization;
+  vector<bool> tensor_basis;
+  vector<int> tensor_nb, tensor_nq;
+  vector<Kokkos::View<ScalarT**,AssemblyDevice> > tensor_val, tensor_grad;
+  vector<Kokkos::View<int*,AssemblyDevice> > tensor_dof, tensor_ip;
+  Kokkos::View<AD*,AssemblyDevice> tensor_coeff, tensor_x0, tensor_x1, tensor_xy00, tensor_xy10, tensor_xy01;
+  Kokkos::View<AD**,AssemblyDevice> tensor_ipvals;
+  
   ScalarT y; // index parameter for fractional operators
   ScalarT s; // fractional exponent
   
@@ -257,6 +322,7 @@ class workset {
   Teuchos::RCP<Teuchos::Time> worksetSideUpdateBasisTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::updateSide - basis data");
   Teuchos::RCP<Teuchos::Time> worksetResetTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::reset*");
   Teuchos::RCP<Teuchos::Time> worksetComputeSolnVolTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::computeSolnVolIP");
+  Teuchos::RCP<Teuchos::Time> worksetIntegrateTensorTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::integrateTensor");
   Teuchos::RCP<Teuchos::Time> worksetComputeSolnSideTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::computeSolnSideIP");
   Teuchos::RCP<Teuchos::Time> worksetComputeParamVolTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::computeParamVolIP");
   Teuchos::RCP<Teuchos::Time> worksetComputeParamSideTimer = Teuchos::TimeMonitor::getNewCounter("MILO::workset::computeParamSideIP");
@@ -17,6 +17,29 @@
 #include "workset.hpp"
 #include "term.hpp"
 
+//////////////////////////////////////////////////////////////////////
+// One step in a compiled function: target (op)= source
+// The data views are resolved when the function is compiled, so evaluating
+// a compiled function does not look anything up by name
+//////////////////////////////////////////////////////////////////////
+
+enum function_opcode {
+  FOP_COPY, FOP_PLUS, FOP_MINUS, FOP_TIMES, FOP_DIVIDE, FOP_POWER,
+  FOP_SIN, FOP_COS, FOP_TAN, FOP_EXP, FOP_LOG, FOP_ABS,
+  FOP_MAX, FOP_MIN, FOP_MEAN, FOP_LT, FOP_LTE, FOP_GT, FOP_GTE,
+  FOP_FILL // target = scalar_source(0) (time, scalar parameters)
+};
+
+struct function_instruction {
+  int opcode;
+  bool targetAD, sourceAD;
+  size_t dim0, dim1;
+  FDATA target, source;
+  FDATAd dtarget, dsource;
+  Kokkos::View<AD*,AssemblyDevice> scalar_source;
+  Kokkos::View<double*,AssemblyDevice> dscalar_source;
+};
+
 class function_class {
 public:
   
@@ -29,6 +52,7 @@ public:
     
     term newt = term(expression);
     terms.push_back(newt);
+    isCompiled = false;
   } ;
   
   ~function_class() {};
@@ -42,6 +66,11 @@ public:
   string function_name, expression, location;
   bool isScalar, isStatic, onSide;
   
+  // Compiled form (see FunctionInterface::compileFunctions)
+  bool isCompiled;
+  vector<int> func_deps; // functions that need to be evaluated first
+  vector<function_instruction> program;
+  
 };
 #endif
 
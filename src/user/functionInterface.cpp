@@ -16,6 +16,7 @@ FunctionInterface::FunctionInterface() {
   known_vars = {"x","y","z","t","nx","ny","nz","pi","h"};
   known_ops = {"sin","cos","exp","log","tan","abs","max","min","mean"};
   verbosity = 0;
+  compile_functions = true;
 }
 
 
@@ -23,6 +24,7 @@ FunctionInterface::FunctionInterface(Teuchos::RCP<Teuchos::ParameterList> & sett
   known_vars = {"x","y","z","t","nx","ny","nz","pi","h"};
   known_ops = {"sin","cos","exp","log","tan","abs","max","min","mean"};
   verbosity = settings->get<int>("verbosity",0);
+  compile_functions = settings->sublist("Solver").get<bool>("compile functions",true);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -540,6 +542,199 @@ void FunctionInterface::decomposeFunctions() {
       }
     }
   }
+  
+  if (compile_functions) {
+    this->compileFunctions();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Compile the decomposed functions into flat lists of instructions
+// Subterms that only depend on constants are evaluated here (once) and functions
+// that use other functions record them in func_deps
+//////////////////////////////////////////////////////////////////////////////////////
+
+void FunctionInterface::compileFunctions() {
+  
+  Teuchos::TimeMonitor ttimer(*decomposeTimer);
+  
+  for (size_t b=0; b<functions.size(); b++) {
+    for (size_t k=0; k<functions[b].size(); k++) {
+      vector<function_instruction> program;
+      vector<int> func_deps;
+      bool compiled = this->compileTerm(b, k, 0, program, func_deps);
+      if (compiled) {
+        functions[b][k].program = program;
+        functions[b][k].func_deps = func_deps;
+      }
+      functions[b][k].isCompiled = compiled;
+      if (verbosity > 10) {
+        cout << "Compiled " << functions[b][k].function_name << " at " << functions[b][k].location
+             << ": " << compiled << " (" << program.size() << " instructions)" << endl;
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Append the instructions for a term (and its dependencies) to a program
+// The order is the same as the recursive evaluation
+//////////////////////////////////////////////////////////////////////////////////////
+
+bool FunctionInterface::compileTerm(const size_t & block, const int & findex, const int & tindex,
+                                    vector<function_instruction> & program, vector<int> & func_deps) {
+  
+  term & cterm = functions[block][findex].terms[tindex];
+  
+  if (cterm.isRoot) {
+    if (cterm.isScalar && !cterm.isConstant) {
+      function_instruction inst;
+      inst.opcode = FOP_FILL;
+      inst.targetAD = cterm.isAD;
+      inst.sourceAD = cterm.isAD;
+      inst.dim0 = functions[block][findex].dim0;
+      inst.dim1 = functions[block][findex].dim1;
+      if (cterm.isAD) {
+        inst.target = cterm.data;
+        inst.scalar_source = cterm.scalar_data;
+      }
+      else {
+        inst.dtarget = cterm.ddata;
+        inst.dscalar_source = cterm.scalar_ddata;
+      }
+      program.push_back(inst);
+    }
+    return true;
+  }
+  else if (cterm.isFunc) {
+    int funcIndex = cterm.funcIndex;
+    if (std::find(func_deps.begin(), func_deps.end(), funcIndex) == func_deps.end()) {
+      func_deps.push_back(funcIndex);
+    }
+    term & fterm = functions[block][funcIndex].terms[0];
+    if (!cterm.isAD && fterm.isAD) {
+      return false;
+    }
+    // The result is copied rather than shared, since the views of the referenced function
+    // are only final once it has been compiled (it may also reference a function)
+    function_instruction inst;
+    inst.opcode = FOP_COPY;
+    inst.targetAD = cterm.isAD;
+    inst.sourceAD = fterm.isAD;
+    if (cterm.isAD) {
+      inst.target = cterm.data;
+      if (fterm.isAD) {
+        inst.source = fterm.data;
+        inst.dim0 = std::min(cterm.data.extent(0),fterm.data.extent(0));
+        inst.dim1 = std::min(cterm.data.extent(1),fterm.data.extent(1));
+      }
+      else {
+        inst.dsource = fterm.ddata;
+        inst.dim0 = std::min(cterm.data.extent(0),fterm.ddata.extent(0));
+        inst.dim1 = std::min(cterm.data.extent(1),fterm.ddata.extent(1));
+      }
+    }
+    else {
+      inst.dtarget = cterm.ddata;
+      inst.dsource = fterm.ddata;
+      inst.dim0 = std::min(cterm.ddata.extent(0),fterm.ddata.extent(0));
+      inst.dim1 = std::min(cterm.ddata.extent(1),fterm.ddata.extent(1));
+    }
+    program.push_back(inst);
+    return true;
+  }
+  else if (!cterm.isAD && this->isConstantTerm(block, findex, tindex)) {
+    // constant folding: ddata will not change
+    this->evaluate(block, findex, tindex);
+    return true;
+  }
+  else {
+    for (size_t k=0; k<cterm.dep_list.size(); k++) {
+      int dep = cterm.dep_list[k];
+      bool depcompiled = this->compileTerm(block, findex, dep, program, func_deps);
+      int opcode = this->getOpcode(cterm.dep_ops[k]);
+      term & dterm = functions[block][findex].terms[dep];
+      if (!depcompiled || opcode < 0 || (!cterm.isAD && dterm.isAD)) {
+        return false;
+      }
+      function_instruction inst;
+      inst.opcode = opcode;
+      inst.targetAD = cterm.isAD;
+      inst.sourceAD = dterm.isAD;
+      if (cterm.isAD) {
+        inst.target = cterm.data;
+        if (dterm.isAD) {
+          inst.source = dterm.data;
+          inst.dim0 = std::min(cterm.data.extent(0),dterm.data.extent(0));
+          inst.dim1 = std::min(cterm.data.extent(1),dterm.data.extent(1));
+        }
+        else {
+          inst.dsource = dterm.ddata;
+          inst.dim0 = std::min(cterm.data.extent(0),dterm.ddata.extent(0));
+          inst.dim1 = std::min(cterm.data.extent(1),dterm.ddata.extent(1));
+        }
+      }
+      else {
+        inst.dtarget = cterm.ddata;
+        inst.dsource = dterm.ddata;
+        inst.dim0 = std::min(cterm.ddata.extent(0),dterm.ddata.extent(0));
+        inst.dim1 = std::min(cterm.ddata.extent(1),dterm.ddata.extent(1));
+      }
+      program.push_back(inst);
+    }
+    return true;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Determine if a term only depends on constants (and can be evaluated once)
+//////////////////////////////////////////////////////////////////////////////////////
+
+bool FunctionInterface::isConstantTerm(const size_t & block, const int & findex, const int & tindex) {
+  bool is_constant = true;
+  if (functions[block][findex].terms[tindex].isRoot) {
+    is_constant = functions[block][findex].terms[tindex].isConstant;
+  }
+  else if (functions[block][findex].terms[tindex].isFunc) {
+    is_constant = false;
+  }
+  else {
+    for (size_t k=0; k<functions[block][findex].terms[tindex].dep_list.size(); k++){
+      bool depcheck = isConstantTerm(block, findex, functions[block][findex].terms[tindex].dep_list[k]);
+      if (!depcheck) {
+        is_constant = false;
+      }
+    }
+  }
+  return is_constant;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Get the opcode for an operator (-1 if there is no opcode)
+//////////////////////////////////////////////////////////////////////////////////////
+
+int FunctionInterface::getOpcode(const string & op) {
+  int opcode = -1;
+  if (op == "") opcode = FOP_COPY;
+  else if (op == "plus") opcode = FOP_PLUS;
+  else if (op == "minus") opcode = FOP_MINUS;
+  else if (op == "times") opcode = FOP_TIMES;
+  else if (op == "divide") opcode = FOP_DIVIDE;
+  else if (op == "power") opcode = FOP_POWER;
+  else if (op == "sin") opcode = FOP_SIN;
+  else if (op == "cos") opcode = FOP_COS;
+  else if (op == "tan") opcode = FOP_TAN;
+  else if (op == "exp") opcode = FOP_EXP;
+  else if (op == "log") opcode = FOP_LOG;
+  else if (op == "abs") opcode = FOP_ABS;
+  else if (op == "max") opcode = FOP_MAX;
+  else if (op == "min") opcode = FOP_MIN;
+  else if (op == "mean") opcode = FOP_MEAN;
+  else if (op == "lt") opcode = FOP_LT;
+  else if (op == "lte") opcode = FOP_LTE;
+  else if (op == "gt") opcode = FOP_GT;
+  else if (op == "gte") opcode = FOP_GTE;
+  return opcode;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -553,9 +748,9 @@ bool FunctionInterface::isScalarTerm(const size_t & block, const int & findex, c
       is_scalar = false;
     }
   }
-  //else if (functions[block][findex].terms[tindex].isFunc) {
-    //is_scalar = false;
-  //}
+  else if (functions[block][findex].terms[tindex].isFunc) {
+    is_scalar = isScalarTerm(block, functions[block][findex].terms[tindex].funcIndex, 0);
+  }
   else {
     for (size_t k=0; k<functions[block][findex].terms[tindex].dep_list.size(); k++){
       bool depcheck = isScalarTerm(block, findex, functions[block][findex].terms[tindex].dep_list[k]);
@@ -573,29 +768,42 @@ bool FunctionInterface::isScalarTerm(const size_t & block, const int & findex, c
 
 FDATA FunctionInterface::evaluate(const string & fname, const string & location,
                                   const size_t & block) {
-  Teuchos::TimeMonitor ttimer(*evaluateTimer);
   
   if (verbosity > 10) {
     cout << endl;
     cout << "Evaluating: " << fname << " at " << location << endl;
   }
   
-  int findex = -1;
-  for (size_t i=0; i<functions[block].size(); i++) {
-    if (fname == functions[block][i].function_name && functions[block][i].location == location) {
-      evaluate(block,i,0);
-      findex = i;
-    }
+  int findex = this->getFunctionIndex(fname, location, block);
+  
+  if (findex == -1) { // meaning that the requested function was not registered at this location
+    TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: function manager could not evaluate: " + fname + " at " + location);
   }
   
+  FDATA data = this->evaluate(findex, block);
+  
   if (verbosity > 10) {
     cout << "Finished evaluating: " << fname << " at " << location << endl;
   }
   
-  if (findex == -1) { // meaning that the requested function was not registered at this location
-    TEUCHOS_TEST_FOR_EXCEPTION(true,std::runtime_error,"Error: function manager could not evaluate: " + fname + " at " + location);
-  }
+  return data;
   
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Evaluate a function using the index returned by addFunction (or getFunctionIndex)
+//////////////////////////////////////////////////////////////////////////////////////
+
+FDATA FunctionInterface::evaluate(const int & findex, const size_t & block) {
+  
+  Teuchos::TimeMonitor ttimer(*evaluateTimer);
+  
+  if (functions[block][findex].isCompiled) {
+    this->evaluateCompiled(block, findex);
+  }
+  else {
+    this->evaluate(block, findex, 0);
+  }
   
   if (!functions[block][findex].terms[0].isAD) {
     parallel_for(RangePolicy<AssemblyDevice>(0,functions[block][findex].dim0), KOKKOS_LAMBDA (const int e ) {
@@ -608,6 +816,23 @@ FDATA FunctionInterface::evaluate(const string & fname, const string & location,
   
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+// Get the index of a function (-1 if it has not been added)
+//////////////////////////////////////////////////////////////////////////////////////
+
+int FunctionInterface::getFunctionIndex(const string & fname, const string & location,
+                                        const size_t & block) {
+  int findex = -1;
+  if (block < functions.size()) {
+    for (size_t i=0; i<functions[block].size(); i++) {
+      if (fname == functions[block][i].function_name && functions[block][i].location == location) {
+        findex = i;
+      }
+    }
+  }
+  return findex;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 // Evaluate a function
 //////////////////////////////////////////////////////////////////////////////////////
@@ -874,6 +1099,196 @@ void FunctionInterface::evaluateOp(T1 data, T2 tdata, const string & op) {
   
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+// Evaluate a compiled function
+// All of the instructions are applied in one loop over the elements
+//////////////////////////////////////////////////////////////////////////////////////
+
+void FunctionInterface::evaluateCompiled(const size_t & block, const int & findex) {
+  
+  for (size_t k=0; k<functions[block][findex].func_deps.size(); k++) {
+    int dep = functions[block][findex].func_deps[k];
+    if (functions[block][dep].isCompiled) {
+      this->evaluateCompiled(block, dep);
+    }
+    else {
+      this->evaluate(block, dep, 0);
+    }
+  }
+  
+  function_instruction * program = functions[block][findex].program.data();
+  size_t numinst = functions[block][findex].program.size();
+  if (numinst == 0) {
+    return;
+  }
+  
+  size_t dim0 = 0;
+  for (size_t i=0; i<numinst; i++) {
+    dim0 = std::max(dim0,program[i].dim0);
+  }
+  
+  parallel_for(RangePolicy<AssemblyDevice>(0,dim0), KOKKOS_LAMBDA (const int e ) {
+    for (size_t i=0; i<numinst; i++) {
+      const function_instruction & inst = program[i];
+      if (e < inst.dim0) {
+        if (inst.opcode == FOP_FILL) {
+          if (inst.targetAD) {
+            for (size_t n=0; n<inst.dim1; n++) {
+              inst.target(e,n) = inst.scalar_source(0);
+            }
+          }
+          else {
+            for (size_t n=0; n<inst.dim1; n++) {
+              inst.dtarget(e,n) = inst.dscalar_source(0);
+            }
+          }
+        }
+        else if (inst.targetAD) {
+          if (inst.sourceAD) {
+            this->applyOp(inst.target, inst.source, e, inst.dim1, inst.opcode);
+          }
+          else {
+            this->applyOp(inst.target, inst.dsource, e, inst.dim1, inst.opcode);
+          }
+        }
+        else {
+          this->applyOp(inst.dtarget, inst.dsource, e, inst.dim1, inst.opcode);
+        }
+      }
+    }
+  });
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Apply one compiled operator on one element (same as evaluateOp)
+//////////////////////////////////////////////////////////////////////////////////////
+
+template<class T1, class T2>
+void FunctionInterface::applyOp(const T1 & data, const T2 & tdata, const int & e, const size_t & dim1, const int & opcode) {
+  
+  switch (opcode) {
+    case FOP_COPY:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = tdata(e,n);
+      }
+      break;
+    case FOP_PLUS:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) += tdata(e,n);
+      }
+      break;
+    case FOP_MINUS:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) += -tdata(e,n);
+      }
+      break;
+    case FOP_TIMES:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) *= tdata(e,n);
+      }
+      break;
+    case FOP_DIVIDE:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) /= tdata(e,n);
+      }
+      break;
+    case FOP_POWER:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = pow(data(e,n),tdata(e,n));
+      }
+      break;
+    case FOP_SIN:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = sin(tdata(e,n));
+      }
+      break;
+    case FOP_COS:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = cos(tdata(e,n));
+      }
+      break;
+    case FOP_TAN:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = tan(tdata(e,n));
+      }
+      break;
+    case FOP_EXP:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = exp(tdata(e,n));
+      }
+      break;
+    case FOP_LOG:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = log(tdata(e,n));
+      }
+      break;
+    case FOP_ABS:
+      for (size_t n=0; n<dim1; n++) {
+        if (tdata(e,n) < 0.0) {
+          data(e,n) = -tdata(e,n);
+        }
+        else {
+          data(e,n) = tdata(e,n);
+        }
+      }
+      break;
+    case FOP_MAX:
+      data(e,0) = tdata(e,0);
+      for (size_t n=0; n<dim1; n++) {
+        if (tdata(e,n) > tdata(e,0)) {
+          data(e,0) = tdata(e,n);
+        }
+      }
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = data(e,0);
+      }
+      break;
+    case FOP_MIN:
+      data(e,0) = tdata(e,0);
+      for (size_t n=0; n<dim1; n++) {
+        if (tdata(e,n) < tdata(e,0)) {
+          data(e,0) = tdata(e,n);
+        }
+      }
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = data(e,0);
+      }
+      break;
+    case FOP_MEAN:
+    {
+      double scale = (double)dim1;
+      data(e,0) = tdata(e,0)/scale;
+      for (size_t n=0; n<dim1; n++) {
+        data(e,0) += tdata(e,n)/scale;
+      }
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = data(e,0);
+      }
+      break;
+    }
+    case FOP_LT:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = (data(e,n) < tdata(e,n)) ? 1.0 : 0.0;
+      }
+      break;
+    case FOP_LTE:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = (data(e,n) <= tdata(e,n)) ? 1.0 : 0.0;
+      }
+      break;
+    case FOP_GT:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = (data(e,n) > tdata(e,n)) ? 1.0 : 0.0;
+      }
+      break;
+    case FOP_GTE:
+      for (size_t n=0; n<dim1; n++) {
+        data(e,n) = (data(e,n) >= tdata(e,n)) ? 1.0 : 0.0;
+      }
+      break;
+  }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 // Print out the function information (mostly for debugging)
 //////////////////////////////////////////////////////////////////////////////////////
@@ -57,6 +57,32 @@ class FunctionInterface {
   //////////////////////////////////////////////////////////////////////////////////////
   
   void decomposeFunctions();
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Compile the decomposed functions into flat lists of instructions
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  void compileFunctions();
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Append the instructions for a term (and its dependencies) to a program
+  // Returns false if the term cannot be compiled
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  bool compileTerm(const size_t & block, const int & findex, const int & tindex,
+                   vector<function_instruction> & program, vector<int> & func_deps);
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Determine if a term only depends on constants (and can be evaluated once)
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  bool isConstantTerm(const size_t & block, const int & findex, const int & tindex);
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Get the opcode for an operator (-1 if there is no opcode)
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  int getOpcode(const string & op);
 
   //////////////////////////////////////////////////////////////////////////////////////
   // Determine if a term is a ScalarT or needs to be an AD type
@@ -70,6 +96,18 @@ class FunctionInterface {
 
   FDATA evaluate(const string & fname, const string & location, const size_t & block);
   
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Evaluate a function using the index returned by addFunction (or getFunctionIndex)
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  FDATA evaluate(const int & findex, const size_t & block);
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Get the index of a function (-1 if it has not been added)
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  int getFunctionIndex(const string & fname, const string & location, const size_t & block);
+  
   //////////////////////////////////////////////////////////////////////////////////////
   // Evaluate a function
   //////////////////////////////////////////////////////////////////////////////////////
@@ -82,6 +120,19 @@ class FunctionInterface {
 
   template<class T1, class T2>
   void evaluateOp(T1 data, T2 tdata, const string & op);
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Evaluate a compiled function
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  void evaluateCompiled(const size_t & block, const int & findex);
+  
+  //////////////////////////////////////////////////////////////////////////////////////
+  // Apply one compiled operator on one element
+  //////////////////////////////////////////////////////////////////////////////////////
+  
+  template<class T1, class T2>
+  void applyOp(const T1 & data, const T2 & tdata, const int & e, const size_t & dim1, const int & opcode);
 
   //////////////////////////////////////////////////////////////////////////////////////
   // Print out the function information (mostly for debugging)
@@ -95,6 +146,7 @@ class FunctionInterface {
 
   size_t numBlocks;
   int verbosity;
+  bool compile_functions;
   vector<vector<function_class> > functions;
   vector<string> known_vars, known_ops, variables, parameters, disc_parameters;
   Teuchos::RCP<workset> wkset;